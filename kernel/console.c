@@ -21,6 +21,8 @@
 #include "riscv.h"
 #include "defs.h"
 #include "proc.h"
+#include "fcntl.h"
+#include "poll.h"
 
 #define BACKSPACE 0x100
 #define C(x)  ((x)-'@')  // Control-x
@@ -76,10 +78,11 @@ consolewrite(int user_src, uint64 src, int n)
 // user read()s from the console go here.
 // copy (up to) a whole input line to dst.
 // user_dist indicates whether dst is a user
-// or kernel address.
+// or kernel address. if nonblock is set, return
+// EAGAIN rather than wait for a line.
 //
 int
-consoleread(int user_dst, uint64 dst, int n)
+consoleread(int user_dst, uint64 dst, int n, int nonblock)
 {
   uint target;
   int c;
@@ -95,6 +98,10 @@ consoleread(int user_dst, uint64 dst, int n)
         release(&cons.lock);
         return -1;
       }
+      if(nonblock){
+        release(&cons.lock);
+        return n < target ? target - n : EAGAIN;
+      }
       sleep(&cons.r, &cons.lock);
     }
 
@@ -172,6 +179,7 @@ consoleintr(int c)
         // has arrived.
         cons.w = cons.e;
         wakeup(&cons.r);
+        pollwakeup();
       }
     }
     break;
@@ -180,6 +188,19 @@ consoleintr(int c)
   release(&cons.lock);
 }
 
+// a line is ready to read, and output never waits long.
+int
+consolepoll(void)
+{
+  int ev = POLLOUT;
+
+  acquire(&cons.lock);
+  if(cons.r != cons.w)
+    ev |= POLLIN;
+  release(&cons.lock);
+  return ev;
+}
+
 void
 consoleinit(void)
 {
@@ -191,4 +212,5 @@ consoleinit(void)
   // to consoleread and consolewrite.
   devsw[CONSOLE].read = consoleread;
   devsw[CONSOLE].write = consolewrite;
+  devsw[CONSOLE].poll = consolepoll;
 }
@@ -1,9 +1,14 @@
 struct buf;
 struct context;
 struct file;
+struct files;
 struct inode;
+struct ioring;
+struct iovec;
+struct lockclass;
 struct pipe;
 struct proc;
+struct rcuhead;
 struct spinlock;
 struct sleeplock;
 struct stat;
@@ -30,13 +35,43 @@ struct file*    filealloc(void);
 void            fileclose(struct file*);
 struct file*    filedup(struct file*);
 void            fileinit(void);
+struct files*   filesalloc(void);
+struct files*   filescopy(struct files*);
+struct files*   filesdup(struct files*);
+void            filesput(struct files*);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+int             filereadv(struct file*, struct iovec*, int, int);
+int             filewritev(struct file*, struct iovec*, int, int);
+int             filesend(struct file*, struct file*, int, int);
+int             filepoll(struct file*);
+
+// futex.c
+void            futexinit(void);
+int             futex_wait(uint64, int);
+int             futex_wake(uint64, int);
+
+// sysfile.c
+struct file*    fdfile(int);
+int             openfd(char*, int);
+int             closefd(int);
+int             statpath(char*, uint64);
+
+// poll.c
+void            pollinit(void);
+void            pollwakeup(void);
+void            polltick(void);
+int             poll(uint64, int, int);
+
+// ioring.c
+uint64          ioring_setup(void);
+int             ioring_enter(int);
 
 // fs.c
 void            fsinit(int);
 int             dirlink(struct inode*, char*, uint);
+void            dirunlink(struct inode*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
@@ -44,6 +79,8 @@ void            iinit();
 void            ilock(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
+void            ilockshared(struct inode*);
+void            iunlockshared(struct inode*);
 void            iunlockput(struct inode*);
 void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
@@ -62,6 +99,7 @@ void            ramdiskrw(struct buf*);
 // kalloc.c
 void*           kalloc(void);
 void            kfree(void *);
+uint64          kfreepages(void);
 void            kinit(void);
 
 // log.c
@@ -70,11 +108,19 @@ void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
 
+// ncache.c
+extern volatile uint ncache_seq;
+void            ncacheinit(void);
+int             ncache_lookup(uint, uint, char*, uint*, short*);
+void            ncache_insert(uint, uint, char*, uint, short, uint);
+void            ncache_remove(uint, uint, char*);
+
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
-int             piperead(struct pipe*, uint64, int);
-int             pipewrite(struct pipe*, uint64, int);
+int             piperead(struct pipe*, int, uint64, int, int);
+int             pipewrite(struct pipe*, int, uint64, int, int);
+int             pipepoll(struct pipe*, int);
 
 // printf.c
 void            printf(char*, ...);
@@ -85,7 +131,9 @@ void            printfinit(void);
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
-int             growproc(int);
+int             clone(uint64, uint64, uint64);
+int             join(uint64);
+int             growproc(int, uint64*);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
@@ -93,18 +141,31 @@ struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
 struct proc*    myproc();
 void            procinit(void);
+void            preempt(int);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
+int             setscheduler(int, int, int);
+int             procstat(uint64, int);
+int             hartstat(uint64, int);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
 void            wakeup(void*);
+void            wakeup_directed(void*);
+void            wakeupproc(struct proc*, void*);
+struct proc*    kthread(char*, void (*)(void*), void*, int);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
 
+// workqueue.c
+void            workinit(void);
+void            workerinit(void);
+int             queue_work(void (*)(void*), void*);
+void            flush_work(void);
+
 // swtch.S
 void            swtch(struct context*, struct context*);
 
@@ -116,9 +177,26 @@ void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
 
+// lockstat.c
+extern int      lockstat_on;
+void            lockstat_acquired(struct lockclass**, char*, int, uint64);
+void            lockstat_released(struct lockclass*, uint64);
+void            lockstat_spun(struct lockclass**, char*, int, int);
+int             lockstat(int, uint64, int);
+
+// rcu.c
+void            rcuinit(void);
+void            rcu_read_lock(void);
+void            rcu_read_unlock(void);
+void            rcu_quiescent(void);
+void            synchronize_rcu(void);
+void            call_rcu(struct rcuhead*, void (*)(struct rcuhead*));
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
+void            acquiresleep_shared(struct sleeplock*);
+void            releasesleep_shared(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
@@ -138,13 +216,18 @@ int             argaddr(int, uint64 *);
 int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
+int             sysstat(int, uint64, int);
+uint64          fastsyscall(int);
 
 // trap.c
 extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
+extern char     uclockpage[];
 void            usertrapret(void);
+uint64          readmtime(void);
+int             cpumode(int);
 
 // uart.c
 void            uartinit(void);
@@ -165,6 +248,7 @@ uint64          uvmalloc(pagetable_t, uint64, uint64);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
+void            uvmfreeall(pagetable_t);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
 uint64          walkaddr(pagetable_t, uint64);
@@ -21,13 +21,18 @@ exec(char *path, char **argv)
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
+  // other threads would lose their memory under them.
+  if(p->vm->ref > 1)
+    return -1;
+
   begin_op();
 
   if((ip = namei(path)) == 0){
     end_op();
     return -1;
   }
-  ilock(ip);
+  // we only read the program file.
+  ilockshared(ip);
 
   // Check ELF header
   if(readi(ip, 0, (uint64)&elf, 0, sizeof(elf)) != sizeof(elf))
@@ -57,12 +62,12 @@ exec(char *path, char **argv)
     if(loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
       goto bad;
   }
-  iunlockput(ip);
+  iunlockshared(ip);
+  iput(ip);
   end_op();
   ip = 0;
 
   p = myproc();
-  uint64 oldsz = p->sz;
 
   // Allocate two pages at the next page boundary.
   // Use the second as the user stack.
@@ -110,8 +115,18 @@ exec(char *path, char **argv)
     
   // Commit to the user image.
   oldpagetable = p->pagetable;
+  uint64 oldsz = p->vm->sz;
+  uvmunmap(oldpagetable, TRAPFRAMEN(p->thread), 1, 0);
+  if(p->vm->ioring)
+    uvmunmap(oldpagetable, IORING, 1, 1);
+  acquire(&p->vm->lock);
+  p->vm->ioring = 0;
+  p->vm->pagetable = pagetable;
+  p->vm->sz = sz;
+  p->vm->threads = 1;
+  release(&p->vm->lock);
   p->pagetable = pagetable;
-  p->sz = sz;
+  p->thread = 0;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
   proc_freepagetable(oldpagetable, oldsz);
@@ -119,10 +134,13 @@ exec(char *path, char **argv)
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
  bad:
-  if(pagetable)
+  if(pagetable){
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
     proc_freepagetable(pagetable, sz);
+  }
   if(ip){
-    iunlockput(ip);
+    iunlockshared(ip);
+    iput(ip);
     end_op();
   }
   return -1;
@@ -12,6 +12,11 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "uio.h"
+#include "poll.h"
+
+static int fileread1(struct file*, int, uint64, int);
+static int filewrite1(struct file*, int, uint64, int);
 
 struct devsw devsw[NDEV];
 struct {
@@ -19,10 +24,20 @@ struct {
   struct file file[NFILE];
 } ftable;
 
+struct {
+  struct spinlock lock;
+  struct files files[NPROC];
+} filestable;
+
 void
 fileinit(void)
 {
+  struct files *fs;
+
   initlock(&ftable.lock, "ftable");
+  initlock(&filestable.lock, "filestable");
+  for(fs = filestable.files; fs < filestable.files + NPROC; fs++)
+    initlock(&fs->lock, "files");
 }
 
 // Allocate a file structure.
@@ -82,6 +97,113 @@ fileclose(struct file *f)
   }
 }
 
+// Allocate an empty open file table.
+struct files*
+filesalloc(void)
+{
+  struct files *fs;
+
+  acquire(&filestable.lock);
+  for(fs = filestable.files; fs < filestable.files + NPROC; fs++){
+    if(fs->ref == 0){
+      fs->ref = 1;
+      release(&filestable.lock);
+      memset(fs->ofile, 0, sizeof(fs->ofile));
+      fs->cwd = 0;
+      return fs;
+    }
+  }
+  release(&filestable.lock);
+  return 0;
+}
+
+// Make a new open file table holding the same files and
+// current directory as fs, for fork().
+struct files*
+filescopy(struct files *fs)
+{
+  struct files *nfs;
+  int fd;
+
+  if((nfs = filesalloc()) == 0)
+    return 0;
+  acquire(&fs->lock);
+  for(fd = 0; fd < NOFILE; fd++)
+    if(fs->ofile[fd])
+      nfs->ofile[fd] = filedup(fs->ofile[fd]);
+  nfs->cwd = idup(fs->cwd);
+  release(&fs->lock);
+  return nfs;
+}
+
+// Share open file table fs, for clone().
+struct files*
+filesdup(struct files *fs)
+{
+  acquire(&filestable.lock);
+  if(fs->ref < 1)
+    panic("filesdup");
+  fs->ref++;
+  release(&filestable.lock);
+  return fs;
+}
+
+// Drop a reference to fs, closing its files
+// and current directory when it is the last.
+void
+filesput(struct files *fs)
+{
+  int fd;
+
+  acquire(&filestable.lock);
+  if(fs->ref < 1)
+    panic("filesput");
+  if(fs->ref > 1){
+    fs->ref--;
+    release(&filestable.lock);
+    return;
+  }
+  release(&filestable.lock);
+
+  // no one else can reach fs now, so it needs no lock.
+  for(fd = 0; fd < NOFILE; fd++){
+    if(fs->ofile[fd]){
+      fileclose(fs->ofile[fd]);
+      fs->ofile[fd] = 0;
+    }
+  }
+  if(fs->cwd){
+    begin_op();
+    iput(fs->cwd);
+    end_op();
+    fs->cwd = 0;
+  }
+
+  acquire(&filestable.lock);
+  fs->ref = 0;
+  release(&filestable.lock);
+}
+
+// Return the POLL events ready on file f.
+int
+filepoll(struct file *f)
+{
+  int ev;
+
+  if(f->type == FD_PIPE)
+    ev = pipepoll(f->pipe, f->writable);
+  else if(f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV &&
+          devsw[f->major].poll)
+    ev = devsw[f->major].poll();
+  else
+    ev = POLLIN | POLLOUT;
+  if(!f->readable)
+    ev &= ~POLLIN;
+  if(!f->writable)
+    ev &= ~POLLOUT;
+  return ev;
+}
+
 // Get metadata about file f.
 // addr is a user virtual address, pointing to a struct stat.
 int
@@ -91,9 +213,9 @@ filestat(struct file *f, uint64 addr)
   struct stat st;
   
   if(f->type == FD_INODE || f->type == FD_DEVICE){
-    ilock(f->ip);
+    ilockshared(f->ip);
     stati(f->ip, &st);
-    iunlock(f->ip);
+    iunlockshared(f->ip);
     if(copyout(p->pagetable, addr, (char *)&st, sizeof(st)) < 0)
       return -1;
     return 0;
@@ -101,10 +223,18 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
-// Read from file f.
+// Read from file f, which the caller got from fdfile().
 // addr is a user virtual address.
 int
 fileread(struct file *f, uint64 addr, int n)
+{
+  return fileread1(f, 1, addr, n);
+}
+
+// Read from file f to dst, a user virtual address
+// if user_dst is 1, or else a kernel address.
+static int
+fileread1(struct file *f, int user_dst, uint64 dst, int n)
 {
   int r = 0;
 
@@ -112,16 +242,27 @@ fileread(struct file *f, uint64 addr, int n)
     return -1;
 
   if(f->type == FD_PIPE){
-    r = piperead(f->pipe, addr, n);
+    r = piperead(f->pipe, user_dst, dst, n, f->nonblock);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].read)
       return -1;
-    r = devsw[f->major].read(1, addr, n);
+    r = devsw[f->major].read(user_dst, dst, n, f->nonblock);
   } else if(f->type == FD_INODE){
-    ilock(f->ip);
-    if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
-      f->off += r;
-    iunlock(f->ip);
+    if(f->ref == 2 && myproc()->files->ref == 1){
+      // no one else can be using f->off, so other readers
+      // of the inode need not wait for us. the two
+      // references are the descriptor's and fdfile()'s.
+      ilockshared(f->ip);
+      if((r = readi(f->ip, user_dst, dst, f->off, n)) > 0)
+        f->off += r;
+      iunlockshared(f->ip);
+    } else {
+      // the inode lock also serializes updates of f->off.
+      ilock(f->ip);
+      if((r = readi(f->ip, user_dst, dst, f->off, n)) > 0)
+        f->off += r;
+      iunlock(f->ip);
+    }
   } else {
     panic("fileread");
   }
@@ -133,6 +274,14 @@ fileread(struct file *f, uint64 addr, int n)
 // addr is a user virtual address.
 int
 filewrite(struct file *f, uint64 addr, int n)
+{
+  return filewrite1(f, 1, addr, n);
+}
+
+// Write to file f from src, a user virtual address
+// if user_src is 1, or else a kernel address.
+static int
+filewrite1(struct file *f, int user_src, uint64 src, int n)
 {
   int r, ret = 0;
 
@@ -140,11 +289,11 @@ filewrite(struct file *f, uint64 addr, int n)
     return -1;
 
   if(f->type == FD_PIPE){
-    ret = pipewrite(f->pipe, addr, n);
+    ret = pipewrite(f->pipe, user_src, src, n, f->nonblock);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
       return -1;
-    ret = devsw[f->major].write(1, addr, n);
+    ret = devsw[f->major].write(user_src, src, n);
   } else if(f->type == FD_INODE){
     // write a few blocks at a time to avoid exceeding
     // the maximum log transaction size, including
@@ -161,7 +310,7 @@ filewrite(struct file *f, uint64 addr, int n)
 
       begin_op();
       ilock(f->ip);
-      if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
+      if ((r = writei(f->ip, user_src, src + i, f->off, n1)) > 0)
         f->off += r;
       iunlock(f->ip);
       end_op();
@@ -180,3 +329,205 @@ filewrite(struct file *f, uint64 addr, int n)
   return ret;
 }
 
+
+// Read from file f, which the caller got from fdfile(), into
+// the n user buffers in iov, at offset off, or at f->off,
+// advancing it, if off < 0.
+// Returns the number of bytes read, or -1.
+int
+filereadv(struct file *f, struct iovec *iov, int n, int off)
+{
+  int i, r, tot, shared;
+  uint o;
+
+  if(f->readable == 0)
+    return -1;
+
+  if(f->type != FD_INODE){
+    // pipes and devices have no offset, and return what is
+    // ready; only the first buffer may wait for data.
+    if(off >= 0)
+      return -1;
+    tot = 0;
+    for(i = 0; i < n; i++){
+      if(iov[i].iov_len == 0)
+        continue;
+      if(tot > 0 && f->type != FD_PIPE)
+        break;
+      if(f->type == FD_PIPE)
+        r = piperead(f->pipe, 1, (uint64)iov[i].iov_base, iov[i].iov_len,
+                     f->nonblock || tot > 0);
+      else
+        r = fileread(f, (uint64)iov[i].iov_base, iov[i].iov_len);
+      if(r < 0)
+        return tot > 0 ? tot : r;
+      tot += r;
+      if(r < iov[i].iov_len)
+        break;
+    }
+    return tot;
+  }
+
+  // readers at their own offsets need not exclude each other.
+  shared = off >= 0 || (f->ref == 2 && myproc()->files->ref == 1);
+  if(shared)
+    ilockshared(f->ip);
+  else
+    ilock(f->ip);
+  o = off >= 0 ? off : f->off;
+  tot = 0;
+  for(i = 0; i < n; i++){
+    r = readi(f->ip, 1, (uint64)iov[i].iov_base, o, iov[i].iov_len);
+    if(r < 0){
+      if(tot == 0)
+        tot = -1;
+      break;
+    }
+    o += r;
+    tot += r;
+    if(r < iov[i].iov_len)
+      break;
+  }
+  if(off < 0)
+    f->off = o;
+  if(shared)
+    iunlockshared(f->ip);
+  else
+    iunlock(f->ip);
+  return tot;
+}
+
+// Write the n user buffers in iov to file f, at offset
+// off, or at f->off, advancing it, if off < 0. Several
+// buffers are written in one log transaction, so that a
+// crash cannot leave some of them written and not others;
+// a vector too big for one is refused. A single buffer may
+// span several transactions, as with write().
+// Returns the number of bytes written, or -1.
+int
+filewritev(struct file *f, struct iovec *iov, int n, int off)
+{
+  int i, r, n1, tot, done, max, failed;
+  uint o;
+  uint64 skip, len;
+
+  if(f->writable == 0)
+    return -1;
+
+  if(f->type != FD_INODE){
+    if(off >= 0)
+      return -1;
+    tot = 0;
+    for(i = 0; i < n; i++){
+      if((r = filewrite(f, (uint64)iov[i].iov_base, iov[i].iov_len)) < 0)
+        return tot > 0 ? tot : r;
+      tot += r;
+      if(r < iov[i].iov_len)
+        break;
+    }
+    return tot;
+  }
+
+  // as in filewrite(): the buffers go to consecutive bytes
+  // of the file, so max bytes touch as few blocks as one
+  // write of max bytes does.
+  max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+  len = 0;
+  for(i = 0; i < n; i++)
+    len += iov[i].iov_len;
+  if(n > 1 && len > max)
+    return -1;
+
+  tot = 0;
+  i = 0;
+  skip = 0;    // bytes of iov[i] already written
+  failed = 0;
+  while(i < n && !failed){
+    begin_op();
+    ilock(f->ip);
+    o = off >= 0 ? off + tot : f->off;
+    for(done = 0; i < n && done < max; ){
+      n1 = iov[i].iov_len - skip;
+      if(n1 > max - done)
+        n1 = max - done;
+      r = writei(f->ip, 1, (uint64)iov[i].iov_base + skip, o, n1);
+      if(r > 0){
+        o += r;
+        done += r;
+        skip += r;
+      }
+      if(r != n1){
+        failed = 1;
+        break;
+      }
+      if(skip == iov[i].iov_len){
+        i++;
+        skip = 0;
+      }
+    }
+    if(off < 0)
+      f->off = o;
+    iunlock(f->ip);
+    end_op();
+
+    tot += done;
+  }
+  if(failed && tot == 0)
+    return -1;
+  return tot;
+}
+
+// Copy up to n bytes from file in to file out inside the
+// kernel, through a page-sized buffer, instead of through
+// user space. Reads in at offset off, leaving in->off alone,
+// or at in->off if off < 0. Stops at the end of in, or when
+// a pipe or device has no more data ready after the first
+// read. Returns the number of bytes copied, or -1.
+int
+filesend(struct file *out, struct file *in, int off, int n)
+{
+  char *buf;
+  int r, w, m, tot;
+
+  if(in->readable == 0 || out->writable == 0)
+    return -1;
+  if(off >= 0 && in->type != FD_INODE)
+    return -1;
+  if((buf = kalloc()) == 0)
+    return -1;
+
+  for(tot = 0; tot < n; tot += w){
+    m = n - tot;
+    if(m > PGSIZE)
+      m = PGSIZE;
+    if(off >= 0){
+      ilockshared(in->ip);
+      r = readi(in->ip, 0, (uint64)buf, off + tot, m);
+      iunlockshared(in->ip);
+    } else if(tot > 0 && in->type == FD_PIPE){
+      // like read(), return what is ready rather than wait.
+      r = piperead(in->pipe, 0, (uint64)buf, m, 1);
+    } else {
+      r = fileread1(in, 0, (uint64)buf, m);
+    }
+    if(r <= 0){
+      if(tot == 0)
+        tot = r;
+      break;
+    }
+    if((w = filewrite1(out, 0, (uint64)buf, r)) != r){
+      // the bytes read but not written are lost, as when a
+      // program's write() after read() fails.
+      if(w > 0)
+        tot += w;
+      else if(tot == 0)
+        tot = -1;
+      break;
+    }
+    if(in->type == FD_DEVICE)
+      break;
+  }
+
+  kfree(buf);
+  return tot;
+}
@@ -3,6 +3,7 @@ struct file {
   int ref; // reference count
   char readable;
   char writable;
+  char nonblock;     // O_NONBLOCK
   struct pipe *pipe; // FD_PIPE
   struct inode *ip;  // FD_INODE and FD_DEVICE
   uint off;          // FD_INODE
@@ -18,6 +19,9 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *hnext; // icache hash chain
+  struct inode *prev; // icache LRU list, if ref is 0
+  struct inode *next;
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -26,13 +30,24 @@ struct inode {
   short minor;
   short nlink;
   uint size;
-  uint addrs[NDIRECT+1];
+  union {
+    uint addrs[NDIRECT+1];
+    struct {                 // if magic == EXTMAGIC; see fs.h
+      uint magic;
+      uint nblocks;
+      uint extblk;
+      uint dindex;
+      uint unused;
+      struct extent ext[NEXTENT];
+    };
+  };
 };
 
 // map major device number to device functions.
 struct devsw {
-  int (*read)(int, uint64, int);
+  int (*read)(int, uint64, int, int);
   int (*write)(int, uint64, int);
+  int (*poll)(void);     // POLLIN and POLLOUT if ready; see poll.c
 };
 
 extern struct devsw devsw[];
@@ -60,28 +60,38 @@ bzero(int dev, int bno)
 
 // Blocks.
 
-// Allocate a zeroed disk block.
+// Allocate a zeroed disk block: the first free one at or
+// after goal, wrapping around, so that a file's blocks can
+// be contiguous.
 static uint
-balloc(uint dev)
+balloc(uint dev, uint goal)
 {
-  int b, bi, m;
+  uint b, n;
+  int bi, m;
   struct buf *bp;
 
+  if(goal >= sb.size)
+    goal = 0;
   bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
-    bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
+  for(n = 0; n < sb.size; n++){
+    b = (goal + n) % sb.size;
+    if(bp == 0 || bp->blockno != BBLOCK(b, sb)){
+      if(bp)
         brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
-      }
+      bp = bread(dev, BBLOCK(b, sb));
+    }
+    bi = b % BPB;
+    m = 1 << (bi % 8);
+    if((bp->data[bi/8] & m) == 0){  // Is block free?
+      bp->data[bi/8] |= m;  // Mark block in use.
+      log_write(bp);
+      brelse(bp);
+      bzero(dev, b);
+      return b;
     }
-    brelse(bp);
   }
+  if(bp)
+    brelse(bp);
   panic("balloc: out of blocks");
 }
 
@@ -102,6 +112,16 @@ bfree(int dev, uint b)
   brelse(bp);
 }
 
+// Free the blocks of extent e.
+static void
+bfreeext(int dev, struct extent *e)
+{
+  uint b;
+
+  for(b = e->start; b < e->start + e->len; b++)
+    bfree(dev, b);
+}
+
 // Inodes.
 //
 // An inode describes a single unnamed file.
@@ -165,26 +185,64 @@ bfree(int dev, uint b)
 // The icache.lock spin-lock protects the allocation of icache
 // entries. Since ip->ref indicates whether an entry is free,
 // and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold icache.lock while using any of those fields.
+// holds, one must hold icache.lock while using any of those fields,
+// or the hash and LRU links.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
-// dev, and inum.  One must hold ip->lock in order to
+// dev, inum, and the links.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
+//
+// Entries are found through a hash table on (dev, inum). Entries
+// with ref 0 stay hashed, so that their contents can be used
+// again, on an LRU list. iget() recycles the least recently used
+// one once NINODE entries exist, and otherwise carves new entries
+// out of a fresh page, so the cache grows for as long as there
+// is memory rather than running out at NINODE referenced inodes.
+
+#define NIHASH 61
 
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *hash[NIHASH];
+  struct inode free;  // LRU list of entries with ref 0, through
+                      // prev/next. free.next is most recent.
+  int n;              // entries allocated
 } icache;
 
 void
 iinit()
 {
-  int i = 0;
-  
   initlock(&icache.lock, "icache");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&icache.inode[i].lock, "inode");
+  icache.free.prev = &icache.free;
+  icache.free.next = &icache.free;
+}
+
+static uint
+ihash(uint dev, uint inum)
+{
+  return (dev * 31 + inum) % NIHASH;
+}
+
+// Add a page of entries to the LRU list.
+// Caller must hold icache.lock.
+static int
+igrow(void)
+{
+  struct inode *ip;
+  char *pg;
+
+  if((pg = kalloc()) == 0)
+    return -1;
+  memset(pg, 0, PGSIZE);
+  for(ip = (struct inode*)pg; ip + 1 <= (struct inode*)(pg + PGSIZE); ip++){
+    initsleeplock(&ip->lock, "inode");
+    ip->next = icache.free.next;
+    ip->prev = &icache.free;
+    icache.free.next->prev = ip;
+    icache.free.next = ip;
+    icache.n++;
   }
+  return 0;
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -205,6 +263,7 @@ ialloc(uint dev, short type)
     if(dip->type == 0){  // a free inode
       memset(dip, 0, sizeof(*dip));
       dip->type = type;
+      dip->magic = EXTMAGIC;
       log_write(bp);   // mark it allocated on the disk
       brelse(bp);
       return iget(dev, inum);
@@ -242,31 +301,46 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip, **pp;
+  uint h;
 
   acquire(&icache.lock);
 
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
+  h = ihash(dev, inum);
+  for(ip = icache.hash[h]; ip; ip = ip->hnext){
+    if(ip->dev == dev && ip->inum == inum){
+      if(ip->ref++ == 0){
+        ip->next->prev = ip->prev;
+        ip->prev->next = ip->next;
+      }
       release(&icache.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
+  // Recycle the least recently used entry, or grow.
+  ip = icache.free.prev;
+  if(ip == &icache.free || (ip->inum && icache.n < NINODE)){
+    igrow();
+    ip = icache.free.prev;
+  }
+  if(ip == &icache.free)
     panic("iget: no inodes");
+  ip->next->prev = ip->prev;
+  ip->prev->next = ip->next;
+  if(ip->inum){
+    for(pp = &icache.hash[ihash(ip->dev, ip->inum)]; *pp != ip; pp = &(*pp)->hnext)
+      ;
+    *pp = ip->hnext;
+  }
 
-  ip = empty;
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->hnext = icache.hash[h];
+  icache.hash[h] = ip;
   release(&icache.lock);
 
   return ip;
@@ -322,6 +396,35 @@ iunlock(struct inode *ip)
   releasesleep(&ip->lock);
 }
 
+// Lock the given inode for reading: any number of processes
+// may hold it this way at once, but none may modify it.
+// Reads the inode from disk if necessary.
+void
+ilockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("ilockshared");
+
+  acquiresleep_shared(&ip->lock);
+  while(ip->valid == 0){
+    // reading it in needs the lock exclusively.
+    releasesleep_shared(&ip->lock);
+    ilock(ip);
+    iunlock(ip);
+    acquiresleep_shared(&ip->lock);
+  }
+}
+
+// Unlock an inode locked by ilockshared().
+void
+iunlockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->lock.readers < 1 || ip->ref < 1)
+    panic("iunlockshared");
+
+  releasesleep_shared(&ip->lock);
+}
+
 // Drop a reference to an in-memory inode.
 // If that was the last reference, the inode cache entry can
 // be recycled.
@@ -353,7 +456,12 @@ iput(struct inode *ip)
     acquire(&icache.lock);
   }
 
-  ip->ref--;
+  if(--ip->ref == 0){
+    ip->next = icache.free.next;
+    ip->prev = &icache.free;
+    icache.free.next->prev = ip;
+    icache.free.next = ip;
+  }
   release(&icache.lock);
 }
 
@@ -368,9 +476,106 @@ iunlockput(struct inode *ip)
 // Inode content
 //
 // The content (data) associated with each inode is stored
-// in blocks on the disk. The first NDIRECT block numbers
-// are listed in ip->addrs[].  The next NINDIRECT blocks are
-// listed in block ip->addrs[NDIRECT].
+// in blocks on the disk. Inodes made by mkfs list the first
+// NDIRECT block numbers in ip->addrs[], and the next NINDIRECT
+// in block ip->addrs[NDIRECT]. Inodes made by ialloc() list
+// runs of blocks as extents: NEXTENT in ip->ext[], then up to
+// NEXTLEAF in each of the leaf blocks listed in the index
+// block ip->extblk. Blocks are only ever added at the end.
+
+// Return the disk block address of the nth block in extent
+// inode ip. If bn is just past the last block, emap appends
+// one, extending the last extent if the next block is free.
+static uint
+emap(struct inode *ip, uint bn)
+{
+  struct buf *xbp, *bp;
+  struct extidx *x;
+  struct extent *e, *last, *slot;
+  uint lblk, addr;
+  int i;
+
+  if(bn > ip->nblocks)
+    panic("emap: hole");
+
+  lblk = 0;
+  last = slot = 0;
+  for(i = 0; i < NEXTENT; i++){
+    e = &ip->ext[i];
+    if(e->len == 0){
+      slot = e;
+      break;
+    }
+    if(bn < lblk + e->len)
+      return e->start + (bn - lblk);
+    lblk += e->len;
+    last = e;
+  }
+
+  xbp = bp = 0;
+  x = 0;
+  if(ip->extblk){
+    // the last leaf whose first block is at or before bn.
+    xbp = bread(ip->dev, ip->extblk);
+    x = (struct extidx*)xbp->data;
+    for(i = 1; i < NEXTIDX && x[i].blk && x[i].lblk <= bn; i++)
+      ;
+    i--;
+    bp = bread(ip->dev, x[i].blk);
+    lblk = x[i].lblk;
+    last = slot = 0;
+    for(e = (struct extent*)bp->data; e < (struct extent*)bp->data + NEXTLEAF; e++){
+      if(e->len == 0){
+        slot = e;
+        break;
+      }
+      if(bn < lblk + e->len){
+        addr = e->start + (bn - lblk);
+        brelse(bp);
+        brelse(xbp);
+        return addr;
+      }
+      lblk += e->len;
+      last = e;
+    }
+  }
+
+  // bn == ip->nblocks: append.
+  addr = balloc(ip->dev, last ? last->start + last->len : 0);
+  if(last && addr == last->start + last->len){
+    last->len++;
+  } else if(slot){
+    slot->start = addr;
+    slot->len = 1;
+  } else {
+    // the inode or the last leaf is full; start a leaf.
+    if(xbp == 0){
+      ip->extblk = balloc(ip->dev, 0);
+      xbp = bread(ip->dev, ip->extblk);
+      x = (struct extidx*)xbp->data;
+      i = 0;
+    } else if(++i >= NEXTIDX){
+      panic("emap: too many extents");
+    }
+    x[i].lblk = bn;
+    x[i].blk = balloc(ip->dev, 0);
+    log_write(xbp);
+    if(bp)
+      brelse(bp);
+    bp = bread(ip->dev, x[i].blk);
+    e = (struct extent*)bp->data;
+    e->start = addr;
+    e->len = 1;
+  }
+  if(bp){
+    log_write(bp);
+    brelse(bp);
+  }
+  if(xbp)
+    brelse(xbp);
+  ip->nblocks++;
+  return addr;
+}
 
 // Return the disk block address of the nth block in inode ip.
 // If there is no such block, bmap allocates one.
@@ -380,9 +585,12 @@ bmap(struct inode *ip, uint bn)
   uint addr, *a;
   struct buf *bp;
 
+  if(ip->magic == EXTMAGIC)
+    return emap(ip, bn);
+
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
+      ip->addrs[bn] = addr = balloc(ip->dev, 0);
     return addr;
   }
   bn -= NDIRECT;
@@ -390,11 +598,11 @@ bmap(struct inode *ip, uint bn)
   if(bn < NINDIRECT){
     // Load indirect block, allocating if necessary.
     if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
+      ip->addrs[NDIRECT] = addr = balloc(ip->dev, 0);
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
     if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
+      a[bn] = addr = balloc(ip->dev, 0);
       log_write(bp);
     }
     brelse(bp);
@@ -404,7 +612,42 @@ bmap(struct inode *ip, uint bn)
   panic("bmap: out of range");
 }
 
+// Free the blocks of extent inode ip.
+static void
+etrunc(struct inode *ip)
+{
+  struct buf *xbp, *bp;
+  struct extidx *x;
+  struct extent *e;
+  int i, j;
+
+  if(ip->dindex){
+    xbp = bread(ip->dev, ip->dindex);
+    for(i = 0; i < ((struct dirindex*)xbp->data)->n; i++)
+      bfree(ip->dev, ((struct dirindex*)xbp->data)->ent[i].blk);
+    brelse(xbp);
+    bfree(ip->dev, ip->dindex);
+  }
+  for(i = 0; i < NEXTENT; i++)
+    bfreeext(ip->dev, &ip->ext[i]);
+  if(ip->extblk == 0)
+    return;
+  xbp = bread(ip->dev, ip->extblk);
+  x = (struct extidx*)xbp->data;
+  for(i = 0; i < NEXTIDX && x[i].blk; i++){
+    bp = bread(ip->dev, x[i].blk);
+    e = (struct extent*)bp->data;
+    for(j = 0; j < NEXTLEAF; j++)
+      bfreeext(ip->dev, &e[j]);
+    brelse(bp);
+    bfree(ip->dev, x[i].blk);
+  }
+  brelse(xbp);
+  bfree(ip->dev, ip->extblk);
+}
+
 // Truncate inode (discard contents).
+// An inode made by mkfs switches to extents.
 // Caller must hold ip->lock.
 void
 itrunc(struct inode *ip)
@@ -413,6 +656,11 @@ itrunc(struct inode *ip)
   struct buf *bp;
   uint *a;
 
+  if(ip->magic == EXTMAGIC){
+    etrunc(ip);
+    goto out;
+  }
+
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
       bfree(ip->dev, ip->addrs[i]);
@@ -432,6 +680,9 @@ itrunc(struct inode *ip)
     ip->addrs[NDIRECT] = 0;
   }
 
+out:
+  memset(ip->addrs, 0, sizeof(ip->addrs));
+  ip->magic = EXTMAGIC;
   ip->size = 0;
   iupdate(ip);
 }
@@ -487,7 +738,7 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 
   if(off > ip->size || off + n < off)
     return -1;
-  if(off + n > MAXFILE*BSIZE)
+  if(ip->magic != EXTMAGIC && off + n > MAXFILE*BSIZE)
     return -1;
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
@@ -506,7 +757,7 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
       ip->size = off;
     // write the i-node back to disk even if the size didn't change
     // because the loop above might have called bmap() and added a new
-    // block to ip->addrs[].
+    // block to ip's block map.
     iupdate(ip);
   }
 
@@ -521,6 +772,233 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
+// Directory index; see struct dirindex in fs.h.
+
+static uint
+dirhash(char *name)
+{
+  uint h = 2166136261;
+  int i;
+
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = (h ^ (uchar)name[i]) * 16777619;
+  return h;
+}
+
+// The leaf of x whose range holds hash h.
+static int
+idxsearch(struct dirindex *x, uint h)
+{
+  int lo, hi, mid;
+
+  lo = 0;
+  hi = x->n - 1;
+  while(lo < hi){
+    mid = (lo + hi + 1) / 2;
+    if(x->ent[mid].hash <= h)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+// The first entry of l whose hash is at least h.
+static int
+leafsearch(struct dirleaf *l, uint h)
+{
+  int lo, hi, mid;
+
+  lo = 0;
+  hi = l->n;
+  while(lo < hi){
+    mid = (lo + hi) / 2;
+    if(l->hash[mid] < h)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Look for name through dp's index.
+// Returns its inode number and sets *poff, or returns 0.
+static uint
+idxlookup(struct inode *dp, char *name, uint *poff)
+{
+  struct buf *bp;
+  struct dirleaf *l;
+  struct dirent de;
+  uint h, off, blk;
+  int i;
+
+  h = dirhash(name);
+  bp = bread(dp->dev, dp->dindex);
+  blk = ((struct dirindex*)bp->data)->ent[idxsearch((struct dirindex*)bp->data, h)].blk;
+  brelse(bp);
+
+  bp = bread(dp->dev, blk);
+  l = (struct dirleaf*)bp->data;
+  for(i = leafsearch(l, h); i < l->n && l->hash[i] == h; i++){
+    off = l->slot[i] * sizeof(de);
+    if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+      panic("idxlookup read");
+    if(de.inum != 0 && namecmp(name, de.name) == 0){
+      brelse(bp);
+      *poff = off;
+      return de.inum;
+    }
+  }
+  brelse(bp);
+  return 0;
+}
+
+// Add slot, holding a name with hash h, to dp's index,
+// splitting a full leaf. Returns 0, or -1 if the index is full.
+static int
+idxinsert(struct inode *dp, uint h, uint slot)
+{
+  struct buf *xbp, *bp, *nbp;
+  struct dirindex *x;
+  struct dirleaf *l, *nl;
+  uint nblk;
+  int i, j, m;
+
+  xbp = bread(dp->dev, dp->dindex);
+  x = (struct dirindex*)xbp->data;
+  i = idxsearch(x, h);
+  bp = bread(dp->dev, x->ent[i].blk);
+  l = (struct dirleaf*)bp->data;
+
+  if(l->n == NDLEAF){
+    // split where the hash changes, near the middle,
+    // so that equal hashes stay in one leaf.
+    for(m = NDLEAF/2; m < NDLEAF && l->hash[m] == l->hash[m-1]; m++)
+      ;
+    if(m == NDLEAF)
+      for(m = NDLEAF/2; m > 0 && l->hash[m] == l->hash[m-1]; m--)
+        ;
+    if(m == 0 || x->n == NDIDX){
+      brelse(bp);
+      brelse(xbp);
+      return -1;
+    }
+    nblk = balloc(dp->dev, 0);
+    nbp = bread(dp->dev, nblk);
+    nl = (struct dirleaf*)nbp->data;
+    nl->n = l->n - m;
+    memmove(nl->hash, &l->hash[m], nl->n * sizeof(l->hash[0]));
+    memmove(nl->slot, &l->slot[m], nl->n * sizeof(l->slot[0]));
+    l->n = m;
+    memmove(&x->ent[i+2], &x->ent[i+1], (x->n - i - 1) * sizeof(x->ent[0]));
+    x->ent[i+1].hash = nl->hash[0];
+    x->ent[i+1].blk = nblk;
+    x->n++;
+    log_write(xbp);
+    log_write(nbp);
+    log_write(bp);
+    if(h >= nl->hash[0]){
+      brelse(bp);
+      bp = nbp;
+      l = nl;
+    } else {
+      brelse(nbp);
+    }
+  }
+
+  j = leafsearch(l, h);
+  memmove(&l->hash[j+1], &l->hash[j], (l->n - j) * sizeof(l->hash[0]));
+  memmove(&l->slot[j+1], &l->slot[j], (l->n - j) * sizeof(l->slot[0]));
+  l->hash[j] = h;
+  l->slot[j] = slot;
+  l->n++;
+  log_write(bp);
+  brelse(bp);
+  brelse(xbp);
+  return 0;
+}
+
+// Remove slot, holding a name with hash h, from dp's index.
+static void
+idxremove(struct inode *dp, uint h, uint slot)
+{
+  struct buf *bp;
+  struct dirleaf *l;
+  uint blk;
+  int i;
+
+  bp = bread(dp->dev, dp->dindex);
+  blk = ((struct dirindex*)bp->data)->ent[idxsearch((struct dirindex*)bp->data, h)].blk;
+  brelse(bp);
+
+  bp = bread(dp->dev, blk);
+  l = (struct dirleaf*)bp->data;
+  for(i = leafsearch(l, h); i < l->n && l->hash[i] == h; i++){
+    if(l->slot[i] == slot){
+      l->n--;
+      memmove(&l->hash[i], &l->hash[i+1], (l->n - i) * sizeof(l->hash[0]));
+      memmove(&l->slot[i], &l->slot[i+1], (l->n - i) * sizeof(l->slot[0]));
+      log_write(bp);
+      break;
+    }
+  }
+  brelse(bp);
+}
+
+// Get or set the free slot chain of dp's index.
+static uint
+idxfree(struct inode *dp, int set, uint free)
+{
+  struct buf *bp;
+  struct dirindex *x;
+
+  bp = bread(dp->dev, dp->dindex);
+  x = (struct dirindex*)bp->data;
+  if(set){
+    x->free = free;
+    log_write(bp);
+  }
+  free = x->free;
+  brelse(bp);
+  return free;
+}
+
+// Give directory dp, which fits in one leaf and has no
+// empty dirents, an index. dirlink() calls this from inside
+// create() and sys_link(), so it must stay well under
+// MAXOPBLOCKS: it writes the bitmap, the index and leaf blocks
+// and dp's inode, and only reads the dirents. Directories in
+// the addrs[] format, such as the root built by mkfs, are
+// never indexed and stay linear.
+static void
+idxbuild(struct inode *dp)
+{
+  struct buf *bp;
+  struct dirindex *x;
+  struct dirent de;
+  uint off, leaf;
+
+  dp->dindex = balloc(dp->dev, 0);
+  leaf = balloc(dp->dev, 0);
+  bp = bread(dp->dev, dp->dindex);
+  x = (struct dirindex*)bp->data;
+  x->n = 1;
+  x->ent[0].hash = 0;
+  x->ent[0].blk = leaf;
+  log_write(bp);
+  brelse(bp);
+  iupdate(dp);
+
+  for(off = 0; off < dp->size; off += sizeof(de)){
+    if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+      panic("idxbuild read");
+    if(de.inum == 0)
+      panic("idxbuild hole");
+    if(idxinsert(dp, dirhash(de.name), off / sizeof(de)) < 0)
+      panic("idxbuild");
+  }
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
 struct inode*
@@ -532,6 +1010,14 @@ dirlookup(struct inode *dp, char *name, uint *poff)
   if(dp->type != T_DIR)
     panic("dirlookup not DIR");
 
+  if(dp->magic == EXTMAGIC && dp->dindex){
+    if((inum = idxlookup(dp, name, &off)) == 0)
+      return 0;
+    if(poff)
+      *poff = off;
+    return iget(dp->dev, inum);
+  }
+
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
       panic("dirlookup read");
@@ -553,7 +1039,8 @@ dirlookup(struct inode *dp, char *name, uint *poff)
 int
 dirlink(struct inode *dp, char *name, uint inum)
 {
-  int off;
+  uint off, free;
+  ushort next;
   struct dirent de;
   struct inode *ip;
 
@@ -562,13 +1049,39 @@ dirlink(struct inode *dp, char *name, uint inum)
     iput(ip);
     return -1;
   }
-
-  // Look for an empty dirent.
-  for(off = 0; off < dp->size; off += sizeof(de)){
-    if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-      panic("dirlink read");
-    if(de.inum == 0)
-      break;
+  ncache_remove(dp->dev, dp->inum, name);  // a negative entry
+
+  if(dp->magic == EXTMAGIC && dp->dindex){
+    // take a free slot, or append.
+    if((free = idxfree(dp, 0, 0)) != 0){
+      off = (free - 1) * sizeof(de);
+      if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+        panic("dirlink read");
+      memmove(&next, de.name, sizeof(next));
+    } else {
+      off = dp->size;
+    }
+    if(off / sizeof(de) >= MAXDSLOT)
+      return -1;
+    if(idxinsert(dp, dirhash(name), off / sizeof(de)) < 0)
+      return -1;
+    if(free)
+      idxfree(dp, 1, next);
+  } else {
+    // Look for an empty dirent.
+    for(off = 0; off < dp->size; off += sizeof(de)){
+      if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+        panic("dirlink read");
+      if(de.inum == 0)
+        break;
+    }
+    // A full directory that outgrew a block gets an index.
+    if(off == dp->size && dp->magic == EXTMAGIC &&
+       dp->size >= BSIZE && dp->size <= NDLEAF*sizeof(de)){
+      idxbuild(dp);
+      if(idxinsert(dp, dirhash(name), off / sizeof(de)) < 0)
+        return -1;
+    }
   }
 
   strncpy(de.name, name, DIRSIZ);
@@ -579,6 +1092,28 @@ dirlink(struct inode *dp, char *name, uint inum)
   return 0;
 }
 
+// Remove the entry at byte offset off from directory dp.
+void
+dirunlink(struct inode *dp, uint off)
+{
+  struct dirent de;
+  ushort next;
+
+  if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+    panic("dirunlink read");
+  if(dp->magic == EXTMAGIC && dp->dindex){
+    idxremove(dp, dirhash(de.name), off / sizeof(de));
+    next = idxfree(dp, 0, 0);
+    idxfree(dp, 1, off / sizeof(de) + 1);
+    memset(&de, 0, sizeof(de));
+    memmove(de.name, &next, sizeof(next));
+  } else {
+    memset(&de, 0, sizeof(de));
+  }
+  if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+    panic("dirunlink");
+}
+
 // Paths
 
 // Copy the next path element from path into name.
@@ -618,6 +1153,67 @@ skipelem(char *path, char *name)
   return path;
 }
 
+// Try to resolve a path for namex() from the name cache alone,
+// without locking any directory; see ncache.c.
+// Returns 1 and sets *ipp to the inode, or to 0 if the path is
+// known not to exist, or returns 0 if some component is not
+// cached.
+static int
+namefast(char *path, int nameiparent, char *name, struct inode **ipp)
+{
+  struct inode *ip;
+  struct files *fs;
+  uint dev, inum, seq;
+  short type;
+
+  if(*path == '/'){
+    dev = ROOTDEV;
+    inum = ROOTINO;
+  } else {
+    fs = myproc()->files;
+    acquire(&fs->lock);
+    dev = fs->cwd->dev;
+    inum = fs->cwd->inum;
+    release(&fs->lock);
+  }
+  type = T_DIR;
+
+  seq = ncache_seq;
+  __sync_synchronize();
+  rcu_read_lock();
+  while((path = skipelem(path, name)) != 0){
+    if(type != T_DIR)
+      goto miss;
+    if(nameiparent && *path == '\0')
+      break;
+    if(name[0] == '.' && name[1] == 0)
+      continue;
+    if(!ncache_lookup(dev, inum, name, &inum, &type))
+      goto miss;
+    if(inum == 0)
+      break;
+  }
+  if(path == 0 && nameiparent)
+    goto miss;
+  ip = inum ? iget(dev, inum) : 0;
+  rcu_read_unlock();
+
+  // if an entry was removed while we looked, it may have been
+  // one we used, and ip might no longer be the right inode.
+  __sync_synchronize();
+  if(seq != ncache_seq){
+    if(ip)
+      iput(ip);
+    return 0;
+  }
+  *ipp = ip;
+  return 1;
+
+miss:
+  rcu_read_unlock();
+  return 0;
+}
+
 // Look up and return the inode for a path name.
 // If parent != 0, return the inode for the parent and copy the final
 // path element into name, which must have room for DIRSIZ bytes.
@@ -626,28 +1222,49 @@ static struct inode*
 namex(char *path, int nameiparent, char *name)
 {
   struct inode *ip, *next;
+  struct files *fs;
+  uint seq;
+
+  if(namefast(path, nameiparent, name, &ip))
+    return ip;
 
   if(*path == '/')
     ip = iget(ROOTDEV, ROOTINO);
-  else
-    ip = idup(myproc()->cwd);
+  else {
+    fs = myproc()->files;
+    acquire(&fs->lock);
+    ip = idup(fs->cwd);
+    release(&fs->lock);
+  }
 
   while((path = skipelem(path, name)) != 0){
-    ilock(ip);
+    // looking in a directory does not change it, so other
+    // lookups may pass through at the same time.
+    ilockshared(ip);
     if(ip->type != T_DIR){
-      iunlockput(ip);
+      iunlockshared(ip);
+      iput(ip);
       return 0;
     }
     if(nameiparent && *path == '\0'){
       // Stop one level early.
-      iunlock(ip);
+      iunlockshared(ip);
       return ip;
     }
+    seq = ncache_seq;
+    __sync_synchronize();
     if((next = dirlookup(ip, name, 0)) == 0){
-      iunlockput(ip);
+      ncache_insert(ip->dev, ip->inum, name, 0, 0, seq);
+      iunlockshared(ip);
+      iput(ip);
       return 0;
     }
-    iunlockput(ip);
+    // next's type is known only if it is already in the
+    // inode cache.
+    ncache_insert(ip->dev, ip->inum, name, next->inum,
+                  next->valid ? next->type : 0, seq);
+    iunlockshared(ip);
+    iput(ip);
     ip = next;
   }
   if(nameiparent){
@@ -26,7 +26,31 @@ struct superblock {
 
 #define NDIRECT 12
 #define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define MAXFILE (NDIRECT + NINDIRECT)   // blocks, for addrs[] inodes
+
+// A run of len data blocks starting at block start.
+struct extent {
+  uint start;
+  uint len;
+};
+
+// Inodes made by the kernel map their blocks with extents
+// instead of addrs[]: ext[] holds the first NEXTENT runs, in
+// file order, and extblk an index of leaf blocks holding the
+// rest. magic tells the two kinds apart, since it can never
+// be a block number in addrs[0].
+#define EXTMAGIC 0xE7E7E7E7
+#define NEXTENT 4
+#define NEXTLEAF (BSIZE / sizeof(struct extent))
+
+// An entry in an extent index block: leaf block blk, whose
+// first extent maps file block lblk.
+struct extidx {
+  uint lblk;
+  uint blk;
+};
+
+#define NEXTIDX (BSIZE / sizeof(struct extidx))
 
 // On-disk inode structure
 struct dinode {
@@ -35,7 +59,17 @@ struct dinode {
   short minor;          // Minor device number (T_DEVICE only)
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
-  uint addrs[NDIRECT+1];   // Data block addresses
+  union {
+    uint addrs[NDIRECT+1];   // Data block addresses
+    struct {
+      uint magic;            // EXTMAGIC
+      uint nblocks;          // blocks mapped
+      uint extblk;           // extent index block, or 0
+      uint dindex;           // directory index block, or 0
+      uint unused;
+      struct extent ext[NEXTENT];
+    };
+  };
 };
 
 // Inodes per block.
@@ -58,3 +92,29 @@ struct dirent {
   char name[DIRSIZ];
 };
 
+// Directories made by the kernel get a hash index once they
+// outgrow a block. dindex is a block holding a struct dirindex,
+// whose entries point, in hash order, to leaf blocks holding
+// struct dirleafs, which list the slots (dirent numbers) of
+// the names that hash into their range. The dirents stay a
+// plain array, so programs that read the directory still work.
+// Free slots are chained through the names of empty dirents.
+#define NDIDX ((BSIZE - 8) / 8)
+#define NDLEAF ((BSIZE - 4) / 6)
+#define MAXDSLOT 0xFFFF         // slots must fit in a ushort
+
+struct dirindex {
+  uint n;                       // leaves
+  uint free;                    // 1 + first free slot, or 0
+  struct {
+    uint hash;                  // least hash in the leaf
+    uint blk;
+  } ent[NDIDX];
+};
+
+struct dirleaf {
+  uint n;
+  uint hash[NDLEAF];            // sorted
+  ushort slot[NDLEAF];
+};
+
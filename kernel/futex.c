@@ -0,0 +1,140 @@
+// Futexes: sleeping on a word of user memory.
+//
+// futex_wait(addr, val) sleeps if the int at addr still holds
+// val, and futex_wake(addr, n) wakes up to n of the sleepers,
+// so user code can build locks that spin only in user space
+// and block in the kernel only when contended. Waiters are
+// kept in a hash table keyed by the physical address of the
+// word, so threads sharing a page find each other whatever
+// virtual address they use.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NFUTEXHASH 61
+
+// a sleeping futex_wait(), on its kernel stack.
+struct futexq {
+  struct proc *p;
+  uint64 key;             // physical address of the word
+  int woken;              // set by futex_wake()
+  struct futexq *next;
+};
+
+struct futexbucket {
+  struct spinlock lock;
+  struct futexq *head;
+};
+
+struct futexbucket futexhash[NFUTEXHASH];
+
+void
+futexinit(void)
+{
+  int i;
+
+  for(i = 0; i < NFUTEXHASH; i++)
+    initlock(&futexhash[i].lock, "futex");
+}
+
+// Find the physical address of the user int at addr,
+// or return 0 if it is not mapped or aligned.
+static uint64
+futexkey(uint64 addr)
+{
+  uint64 pa;
+
+  if(addr % sizeof(int) != 0)
+    return 0;
+  if((pa = walkaddr(myproc()->pagetable, PGROUNDDOWN(addr))) == 0)
+    return 0;
+  return pa + (addr - PGROUNDDOWN(addr));
+}
+
+static struct futexbucket*
+futexbucket(uint64 key)
+{
+  return &futexhash[(key / sizeof(int)) % NFUTEXHASH];
+}
+
+// Sleep until woken by futex_wake(), if the int at
+// addr is val. Returns 0 if woken, -1 if *addr was not
+// val, the address is bad, or we were killed.
+int
+futex_wait(uint64 addr, int val)
+{
+  struct futexbucket *b;
+  struct futexq q, **qq;
+  struct proc *p = myproc();
+  uint64 key;
+
+  if((key = futexkey(addr)) == 0)
+    return -1;
+  b = futexbucket(key);
+
+  acquire(&b->lock);
+  // futex_wake() takes the lock too, so a wake that follows
+  // a change to *addr cannot slip in before we sleep.
+  if(*(volatile int*)key != val){
+    release(&b->lock);
+    return -1;
+  }
+  q.p = p;
+  q.key = key;
+  q.woken = 0;
+  q.next = 0;
+  // at the tail, so waiters are woken in order.
+  for(qq = &b->head; *qq; qq = &(*qq)->next)
+    ;
+  *qq = &q;
+
+  while(!q.woken && !p->killed)
+    sleep(&q, &b->lock);
+
+  if(!q.woken){
+    for(qq = &b->head; *qq; qq = &(*qq)->next){
+      if(*qq == &q){
+        *qq = q.next;
+        break;
+      }
+    }
+  }
+  release(&b->lock);
+  return q.woken ? 0 : -1;
+}
+
+// Wake up to n processes sleeping in futex_wait() on
+// addr. Returns how many were woken, or -1 if the
+// address is bad.
+int
+futex_wake(uint64 addr, int n)
+{
+  struct futexbucket *b;
+  struct futexq *q, **qq;
+  uint64 key;
+  int woken = 0;
+
+  if((key = futexkey(addr)) == 0)
+    return -1;
+  b = futexbucket(key);
+
+  acquire(&b->lock);
+  qq = &b->head;
+  while((q = *qq) != 0 && woken < n){
+    if(q->key != key){
+      qq = &q->next;
+      continue;
+    }
+    *qq = q->next;
+    q->woken = 1;
+    wakeupproc(q->p, q);
+    woken++;
+  }
+  release(&b->lock);
+  return woken;
+}
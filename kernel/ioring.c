@@ -0,0 +1,129 @@
+// Batched system calls through shared-memory rings.
+//
+// A program queues read, write, open, close, fstat and stat
+// calls in the submission ring and makes one ioring_enter()
+// system call to run a whole batch, instead of a trap per call.
+// The ring page belongs to the address space, so clone()d
+// threads share it; they must not enter it at the same time.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "ioring.h"
+#include "defs.h"
+
+// Map a ring page into the caller's address space, if it
+// has none yet. Returns its user address, or -1.
+uint64
+ioring_setup(void)
+{
+  struct vmspace *vm = myproc()->vm;
+  char *mem;
+
+  acquire(&vm->lock);
+  if(vm->ioring == 0){
+    if((mem = kalloc()) == 0){
+      release(&vm->lock);
+      return -1;
+    }
+    memset(mem, 0, PGSIZE);
+    if(mappages(vm->pagetable, IORING, PGSIZE, (uint64)mem,
+                PTE_R | PTE_W | PTE_U) < 0){
+      kfree(mem);
+      release(&vm->lock);
+      return -1;
+    }
+    vm->ioring = (struct ioring*)mem;
+  }
+  release(&vm->lock);
+  return IORING;
+}
+
+// Run one submission. The arguments are the program's to
+// choose, so each operation checks them like a system call.
+static int
+iorun(struct iosqe *sqe)
+{
+  char path[MAXPATH];
+  struct file *f;
+  int r;
+
+  switch(sqe->op){
+  case IORING_OP_NOP:
+    return 0;
+  case IORING_OP_OPEN:
+    if(fetchstr(sqe->addr, path, MAXPATH) < 0)
+      return -1;
+    return openfd(path, sqe->len);
+  case IORING_OP_CLOSE:
+    return closefd(sqe->fd);
+  case IORING_OP_STAT:
+    if(fetchstr(sqe->addr, path, MAXPATH) < 0)
+      return -1;
+    return statpath(path, sqe->addr2);
+  }
+
+  // the rest work on an open file.
+  if((f = fdfile(sqe->fd)) == 0)
+    return -1;
+  r = -1;
+  switch(sqe->op){
+  case IORING_OP_READ:
+    if(sqe->len >= 0)
+      r = fileread(f, sqe->addr, sqe->len);
+    break;
+  case IORING_OP_WRITE:
+    if(sqe->len >= 0)
+      r = filewrite(f, sqe->addr, sqe->len);
+    break;
+  case IORING_OP_FSTAT:
+    r = filestat(f, sqe->addr);
+    break;
+  }
+  fileclose(f);
+  return r;
+}
+
+// Run up to n queued submissions, or all of them if n is 0,
+// stopping early if the completion ring fills up.
+// Returns how many were run, or -1 if there is no ring.
+int
+ioring_enter(int n)
+{
+  struct proc *p = myproc();
+  volatile struct ioring *r = p->vm->ioring;
+  struct iosqe sqe;
+  uint head;
+  int done, res, lastfd;
+
+  if(r == 0)
+    return -1;
+
+  lastfd = -1;
+  for(done = 0; n <= 0 || done < n; done++){
+    head = r->sqhead;
+    if(head == r->sqtail || r->cqtail - r->cqhead >= NIOCQ || p->killed)
+      break;
+    // read the entry only after seeing the tail that covers
+    // it, and reuse a completion slot only after seeing that
+    // the program has consumed it.
+    __sync_synchronize();
+    // copy it, so the program cannot change it under us.
+    sqe = *(struct iosqe*)&r->sq[head % NIOSQ];
+    if(sqe.flags & IOSQE_PREVFD)
+      sqe.fd = lastfd;
+    res = iorun(&sqe);
+    if(sqe.op == IORING_OP_OPEN)
+      lastfd = res;
+    r->cq[r->cqtail % NIOCQ].data = sqe.data;
+    r->cq[r->cqtail % NIOCQ].res = res;
+    // the program must see the completion before the new tail.
+    __sync_synchronize();
+    r->cqtail++;
+    r->sqhead = head + 1;
+  }
+  return done;
+}
@@ -0,0 +1,51 @@
+// Submission and completion rings, for making many system
+// calls per kernel entry; see ioring.c.
+//
+// ioring_setup() maps a struct ioring, one page, into the
+// process. The program fills in iosqe entries at sqtail and
+// advances sqtail; ioring_enter() runs entries from sqhead,
+// advancing it, and posts an iocqe for each at cqtail. The
+// program consumes completions from cqhead. Indices only
+// ever increase; take them modulo the ring size.
+
+// operations.
+#define IORING_OP_NOP    0
+#define IORING_OP_READ   1   // read(fd, addr, len)
+#define IORING_OP_WRITE  2   // write(fd, addr, len)
+#define IORING_OP_OPEN   3   // open(addr, len), len is the O_ mode
+#define IORING_OP_CLOSE  4   // close(fd)
+#define IORING_OP_FSTAT  5   // fstat(fd, addr)
+#define IORING_OP_STAT   6   // stat(addr, addr2)
+
+// iosqe flags.
+#define IOSQE_PREVFD     1   // use the fd from this batch's latest open
+
+#define NIOSQ 64
+#define NIOCQ 64
+
+struct iosqe {
+  uchar op;          // IORING_OP_*
+  uchar flags;       // IOSQE_*
+  ushort pad;
+  int fd;
+  int len;
+  int pad2;
+  uint64 addr;       // buffer, path, or struct stat
+  uint64 addr2;      // struct stat for IORING_OP_STAT
+  uint64 data;       // copied to the completion
+};
+
+struct iocqe {
+  uint64 data;       // from the submission
+  int res;           // what the system call would have returned
+  int pad;
+};
+
+struct ioring {
+  uint sqhead;       // advanced by the kernel
+  uint sqtail;       // advanced by the program
+  uint cqhead;       // advanced by the program
+  uint cqtail;       // advanced by the kernel
+  struct iosqe sq[NIOSQ];
+  struct iocqe cq[NIOCQ];
+};
@@ -0,0 +1,165 @@
+// Lock contention statistics.
+//
+// While collection is on, acquire() and acquiresleep() count
+// acquisitions and waiting, and time how long each lock is held,
+// per lock name. The counters are updated with atomic adds and
+// no locks, since they are kept for locks.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "lockstat.h"
+#include "defs.h"
+
+// All locks with the same name and kind share a class.
+// Times are in CLINT_MTIME cycles.
+struct lockclass {
+  char *name;               // set once, when the class is claimed
+  int kind;
+  int ready;                // name and kind are valid
+  uint64 acquires;
+  uint64 contended;
+  uint64 spins;
+  uint64 holdtime;
+  uint64 maxhold;
+  uint64 spinwins;
+  uint64 spinlosses;
+};
+
+struct lockclass lockclass[NLOCKSTAT];
+
+int lockstat_on;            // collect statistics?
+
+// Find or claim the class for name and kind, or return 0 if the
+// table is full. Interrupts must be off, so that a class is never
+// left claimed but not ready while its claimer is off the CPU.
+static struct lockclass*
+lookup(char *name, int kind)
+{
+  struct lockclass *c;
+
+  for(c = lockclass; c < &lockclass[NLOCKSTAT]; c++){
+    if(c->name == 0 && __sync_bool_compare_and_swap(&c->name, 0, name)){
+      c->kind = kind;
+      __sync_synchronize();
+      c->ready = 1;
+      return c;
+    }
+    while(*(volatile int*)&c->ready == 0)
+      ;
+    __sync_synchronize();
+    if(c->kind == kind &&
+       (c->name == name || strncmp(c->name, name, 16) == 0))
+      return c;
+  }
+  return 0;
+}
+
+// Count an acquisition of a lock of this name and kind,
+// after waiting for spins polls (or sleeps). *cp caches the
+// lock's class.
+void
+lockstat_acquired(struct lockclass **cp, char *name, int kind, uint64 spins)
+{
+  struct lockclass *c;
+
+  if((c = *cp) == 0){
+    push_off();
+    c = *cp = lookup(name, kind);
+    pop_off();
+    if(c == 0)
+      return;
+  }
+  __sync_fetch_and_add(&c->acquires, 1);
+  if(spins){
+    __sync_fetch_and_add(&c->contended, 1);
+    __sync_fetch_and_add(&c->spins, spins);
+  }
+}
+
+// Count a wait for a sleeplock that spun while its holder
+// was running, which ended with the lock let go if won,
+// or else with a sleep.
+void
+lockstat_spun(struct lockclass **cp, char *name, int kind, int won)
+{
+  struct lockclass *c;
+
+  if((c = *cp) == 0){
+    push_off();
+    c = *cp = lookup(name, kind);
+    pop_off();
+    if(c == 0)
+      return;
+  }
+  __sync_fetch_and_add(won ? &c->spinwins : &c->spinlosses, 1);
+}
+
+// Count a release of a lock of class c after holding it for
+// t cycles.
+void
+lockstat_released(struct lockclass *c, uint64 t)
+{
+  uint64 max;
+
+  if(c == 0)
+    return;
+  __sync_fetch_and_add(&c->holdtime, t);
+  while(t > (max = c->maxhold))
+    if(__sync_bool_compare_and_swap(&c->maxhold, max, t))
+      break;
+}
+
+// Turn collection on or off, zero the counters, or copy up to n
+// classes as struct lockstat to user address addr.
+// Returns 0, or the number of classes copied for LOCKSTAT_READ,
+// or -1 on error.
+int
+lockstat(int cmd, uint64 addr, int n)
+{
+  struct lockclass *c;
+  struct lockstat ls;
+  int i = 0, scale = MTIME_HZ / 1000000;
+
+  switch(cmd){
+  case LOCKSTAT_OFF:
+    lockstat_on = 0;
+    return 0;
+  case LOCKSTAT_ON:
+    lockstat_on = 1;
+    return 0;
+  case LOCKSTAT_RESET:
+    for(c = lockclass; c < &lockclass[NLOCKSTAT]; c++){
+      c->acquires = 0;
+      c->contended = 0;
+      c->spins = 0;
+      c->holdtime = 0;
+      c->maxhold = 0;
+      c->spinwins = 0;
+      c->spinlosses = 0;
+    }
+    return 0;
+  case LOCKSTAT_READ:
+    for(c = lockclass; c < &lockclass[NLOCKSTAT] && i < n; c++){
+      if(c->ready == 0)
+        continue;
+      safestrcpy(ls.name, c->name, sizeof(ls.name));
+      ls.kind = c->kind;
+      ls.acquires = c->acquires;
+      ls.contended = c->contended;
+      ls.spins = c->spins;
+      ls.holdtime = c->holdtime / scale;
+      ls.maxhold = c->maxhold / scale;
+      ls.spinwins = c->spinwins;
+      ls.spinlosses = c->spinlosses;
+      if(copyout(myproc()->pagetable, addr + i*sizeof(ls), (char*)&ls, sizeof(ls)) < 0)
+        return -1;
+      i++;
+    }
+    return i;
+  }
+  return -1;
+}
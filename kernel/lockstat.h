@@ -0,0 +1,27 @@
+// Lock contention statistics; see lockstat().
+
+// lockstat() commands.
+#define LOCKSTAT_OFF    0   // stop collecting
+#define LOCKSTAT_ON     1   // start collecting
+#define LOCKSTAT_RESET  2   // zero the counters
+#define LOCKSTAT_READ   3   // copy out up to n struct lockstat
+
+#define NLOCKSTAT      64   // distinct lock names tracked
+
+#define LOCK_SPIN       0   // struct spinlock
+#define LOCK_SLEEP      1   // struct sleeplock
+
+// Counters for all locks of one kind with the same name.
+// Times are in microseconds.
+struct lockstat {
+  char name[16];
+  int kind;                 // LOCK_SPIN or LOCK_SLEEP
+  uint64 acquires;          // times acquired
+  uint64 contended;         // times acquired after waiting
+  uint64 spins;             // times the lock was polled, or slept on, while waiting
+  uint64 holdtime;          // total time held
+  uint64 maxhold;           // longest time held
+  uint64 spinwins;          // sleeplock waits that spun on a running holder
+                            // and saw it let go, avoiding a sleep
+  uint64 spinlosses;        // ... and gave up and slept
+};
@@ -26,8 +26,14 @@ main()
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
     iinit();         // inode cache
+    ncacheinit();    // directory name cache
     fileinit();      // file table
+    futexinit();     // futex wait queues
+    pollinit();      // poll() wait queue
     virtio_disk_init(); // emulated hard disk
+    workinit();      // deferred work queues
+    rcuinit();       // deferred freeing for lock-free readers
+    workerinit();    // this hart's worker thread
     userinit();      // first user process
     __sync_synchronize();
     started = 1;
@@ -39,6 +45,7 @@ main()
     kvminithart();    // turn on paging
     trapinithart();   // install kernel trap vector
     plicinithart();   // ask PLIC for device interrupts
+    workerinit();     // this hart's worker thread
   }
 
   scheduler();        
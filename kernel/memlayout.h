@@ -29,6 +29,7 @@
 #define CLINT 0x2000000L
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define MTIME_HZ 10000000            // CLINT_MTIME rate in qemu.
 
 // qemu puts programmable interrupt controller here.
 #define PLIC 0x0c000000L
@@ -62,6 +63,16 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   IORING (submission and completion rings, struct ioring)
+//   TRAPFRAMEN(NTHREAD-1) ... TRAPFRAMEN(1) (of clone()d threads)
+//   UCLOCK (read-only clock page, struct uclock)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define UCLOCK (TRAPFRAME - PGSIZE)
+
+// where thread t of an address space has its trapframe.
+#define TRAPFRAMEN(t) ((t) == 0 ? TRAPFRAME : UCLOCK - (t)*PGSIZE)
+
+// the page ioring_setup() maps, below all the trapframes.
+#define IORING (UCLOCK - NTHREAD*PGSIZE)
@@ -0,0 +1,183 @@
+// Directory name cache.
+//
+// Maps (device, directory inode number, name) to the inode
+// number (and, if known, type) that the name refers to, so
+// that namex() can resolve cached paths without locking each
+// directory on the way. A negative entry, with inum 0, records
+// that the directory has no such name. Lookups take no locks;
+// the hash chains are protected by RCU, and entries are
+// recycled only after a grace period.
+//
+// Entries must never outlive what they cache. Directory entries
+// go away only in unlink, and appear only in dirlink(); both call
+// ncache_remove(), which bumps ncache_seq if it removes an entry.
+// Lookups that may have raced with that check ncache_seq and give
+// up. Insertions happen with the directory locked, so cannot
+// race with either.
+// "." and ".." are never cached.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "rcu.h"
+#include "defs.h"
+
+#define NNCACHE 128
+#define NNCHASH 61
+
+struct ncentry {
+  struct rcuhead rcu;             // must be first; see ncfree()
+  struct ncentry *volatile next;  // hash chain
+  uint dev;
+  uint dinum;                     // directory
+  char name[DIRSIZ];
+  uint inum;                      // what name refers to
+  short type;                     // of inum, or 0 if not known
+};
+
+struct {
+  struct spinlock lock;           // for changes; lookups are lock-free
+  struct ncentry *volatile hash[NNCHASH];
+  struct ncentry *free;
+  int hand;                       // next bucket to evict from
+  struct ncentry entry[NNCACHE];
+} ncache;
+
+// bumped whenever a directory entry is removed.
+volatile uint ncache_seq;
+
+void
+ncacheinit(void)
+{
+  int i;
+
+  initlock(&ncache.lock, "ncache");
+  for(i = 0; i < NNCACHE; i++){
+    ncache.entry[i].next = ncache.free;
+    ncache.free = &ncache.entry[i];
+  }
+}
+
+static uint
+nchash(uint dev, uint dinum, char *name)
+{
+  uint h = dev * 31 + dinum;
+  int i;
+
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = h * 31 + (uchar)name[i];
+  return h % NNCHASH;
+}
+
+static void
+ncfree(struct rcuhead *h)
+{
+  struct ncentry *e = (struct ncentry*)h;
+
+  acquire(&ncache.lock);
+  e->next = ncache.free;
+  ncache.free = e;
+  release(&ncache.lock);
+}
+
+// Look up name in directory dinum. Caller must be in an RCU
+// read-side critical section.
+// Returns 1 and sets *inum and *type if found, else 0.
+// *inum is 0 if name is known not to exist.
+int
+ncache_lookup(uint dev, uint dinum, char *name, uint *inum, short *type)
+{
+  struct ncentry *e;
+
+  for(e = ncache.hash[nchash(dev, dinum, name)]; e; e = e->next){
+    if(e->dev == dev && e->dinum == dinum && namecmp(e->name, name) == 0){
+      *inum = e->inum;
+      *type = e->type;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Record that name in directory dinum refers to inode inum,
+// of the given type (or 0), or, if inum is 0, that there is
+// no such name. seq is ncache_seq from before
+// the directory was searched; if an entry has been removed
+// since, do nothing, since it might have been this one.
+// Also does nothing if the cache is full; see below.
+void
+ncache_insert(uint dev, uint dinum, char *name, uint inum, short type, uint seq)
+{
+  struct ncentry *e, *victim;
+  uint h;
+
+  if(name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+    return;
+
+  h = nchash(dev, dinum, name);
+  acquire(&ncache.lock);
+  if(seq != ncache_seq)
+    goto out;
+  for(e = ncache.hash[h]; e; e = e->next){
+    if(e->dev == dev && e->dinum == dinum && namecmp(e->name, name) == 0){
+      if(type && e->inum == inum)
+        e->type = type;
+      goto out;
+    }
+  }
+
+  if((e = ncache.free) == 0){
+    // no free entry, so this insert is dropped. make room
+    // for a later one by dropping the head of some other
+    // chain; readers may still be using it, so it reaches
+    // the free list only after call_rcu().
+    for(int i = 0; i < NNCHASH; i++){
+      ncache.hand = (ncache.hand + 1) % NNCHASH;
+      if((victim = ncache.hash[ncache.hand]) != 0){
+        ncache.hash[ncache.hand] = victim->next;
+        call_rcu(&victim->rcu, ncfree);
+        break;
+      }
+    }
+    goto out;
+  }
+  ncache.free = e->next;
+
+  e->dev = dev;
+  e->dinum = dinum;
+  strncpy(e->name, name, DIRSIZ);
+  e->inum = inum;
+  e->type = type;
+  e->next = ncache.hash[h];
+  // make the entry's contents visible before the entry.
+  __sync_synchronize();
+  ncache.hash[h] = e;
+out:
+  release(&ncache.lock);
+}
+
+// Forget name in directory dinum, which is being removed
+// or created. Caller must hold the directory's lock.
+void
+ncache_remove(uint dev, uint dinum, char *name)
+{
+  struct ncentry *e;
+  struct ncentry *volatile *pp;
+
+  acquire(&ncache.lock);
+  for(pp = &ncache.hash[nchash(dev, dinum, name)]; (e = *pp) != 0; pp = &e->next){
+    if(e->dev == dev && e->dinum == dinum && namecmp(e->name, name) == 0){
+      // readers may still be looking at e; it keeps
+      // pointing to the rest of the chain.
+      ncache_seq++;
+      *pp = e->next;
+      call_rcu(&e->rcu, ncfree);
+      break;
+    }
+  }
+  release(&ncache.lock);
+}
@@ -2,12 +2,17 @@
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NINODE       50  // i-nodes cached before unused ones are recycled
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define FSSIZE       4000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define NSCHEDHIST    16   // buckets in scheduler latency histograms
+#define NCPUMODE       4   // user, kernel, interrupt and idle time
+#define NWORK         64   // deferred work items queued at once
+#define NTHREAD       16   // threads sharing one address space
+#define MAXIOV        16   // buffers per readv() or writev()
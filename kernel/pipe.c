@@ -7,6 +7,8 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "fcntl.h"
+#include "poll.h"
 
 #define PIPESIZE 512
 
@@ -38,10 +40,12 @@ pipealloc(struct file **f0, struct file **f1)
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
   (*f0)->writable = 0;
+  (*f0)->nonblock = 0;
   (*f0)->pipe = pi;
   (*f1)->type = FD_PIPE;
   (*f1)->readable = 0;
   (*f1)->writable = 1;
+  (*f1)->nonblock = 0;
   (*f1)->pipe = pi;
   return 0;
 
@@ -66,6 +70,7 @@ pipeclose(struct pipe *pi, int writable)
     pi->readopen = 0;
     wakeup(&pi->nwrite);
   }
+  pollwakeup();
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
     kfree((char*)pi);
@@ -74,7 +79,7 @@ pipeclose(struct pipe *pi, int writable)
 }
 
 int
-pipewrite(struct pipe *pi, uint64 addr, int n)
+pipewrite(struct pipe *pi, int user_src, uint64 addr, int n, int nonblock)
 {
   int i;
   char ch;
@@ -87,20 +92,28 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
         release(&pi->lock);
         return -1;
       }
-      wakeup(&pi->nread);
+      if(nonblock){
+        wakeup_directed(&pi->nread);
+        pollwakeup();
+        release(&pi->lock);
+        return i > 0 ? i : EAGAIN;
+      }
+      wakeup_directed(&pi->nread);
+      pollwakeup();
       sleep(&pi->nwrite, &pi->lock);
     }
-    if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
+    if(either_copyin(&ch, user_src, addr + i, 1) == -1)
       break;
     pi->data[pi->nwrite++ % PIPESIZE] = ch;
   }
-  wakeup(&pi->nread);
+  wakeup_directed(&pi->nread);
+  pollwakeup();
   release(&pi->lock);
   return i;
 }
 
 int
-piperead(struct pipe *pi, uint64 addr, int n)
+piperead(struct pipe *pi, int user_dst, uint64 addr, int n, int nonblock)
 {
   int i;
   struct proc *pr = myproc();
@@ -112,16 +125,44 @@ piperead(struct pipe *pi, uint64 addr, int n)
       release(&pi->lock);
       return -1;
     }
+    if(nonblock){
+      release(&pi->lock);
+      return EAGAIN;
+    }
     sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
   for(i = 0; i < n; i++){  //DOC: piperead-copy
     if(pi->nread == pi->nwrite)
       break;
     ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+    if(either_copyout(user_dst, addr + i, &ch, 1) == -1)
       break;
   }
-  wakeup(&pi->nwrite);  //DOC: piperead-wakeup
+  wakeup_directed(&pi->nwrite);  //DOC: piperead-wakeup
+  pollwakeup();
   release(&pi->lock);
   return i;
 }
+
+// Return the POLL events ready on the read end of
+// pi, or the write end if writable is set.
+int
+pipepoll(struct pipe *pi, int writable)
+{
+  int ev = 0;
+
+  acquire(&pi->lock);
+  if(writable){
+    if(pi->readopen == 0)
+      ev = POLLOUT | POLLHUP;  // write() would fail at once
+    else if(pi->nwrite != pi->nread + PIPESIZE)
+      ev = POLLOUT;
+  } else {
+    if(pi->nread != pi->nwrite)
+      ev = POLLIN;
+    if(pi->writeopen == 0)
+      ev |= POLLIN | POLLHUP;  // read() would return 0
+  }
+  release(&pi->lock);
+  return ev;
+}
@@ -0,0 +1,134 @@
+// poll(): wait until one of several files is ready.
+//
+// Rather than a wait queue per file, there is one shared
+// queue. Anything that may make a file ready (pipe reads,
+// writes and closes, console input) calls pollwakeup(),
+// which wakes every process in poll() to look again. That
+// costs a check of pollq.npoll when no one is polling.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "poll.h"
+#include "defs.h"
+
+struct {
+  struct spinlock lock;
+  uint seq;           // bumped by each pollwakeup()
+  int npoll;          // processes in poll()
+  int ntimed;         // ... with a timeout, woken every tick
+} pollq;
+
+void
+pollinit(void)
+{
+  initlock(&pollq.lock, "poll");
+}
+
+// Some file may have become ready.
+void
+pollwakeup(void)
+{
+  // pairs with the barrier in poll() between counting
+  // itself in pollq.npoll and looking at the files.
+  __sync_synchronize();
+  if(pollq.npoll == 0)
+    return;
+  acquire(&pollq.lock);
+  pollq.seq++;
+  wakeup(&pollq.seq);
+  release(&pollq.lock);
+}
+
+// Called at each clock tick, for poll()s with timeouts.
+void
+polltick(void)
+{
+  if(pollq.ntimed)
+    pollwakeup();
+}
+
+// Set revents for each of the n entries in pfd.
+// Returns how many have some event.
+static int
+pollscan(struct pollfd *pfd, int n)
+{
+  struct file *f;
+  int i, nready;
+
+  nready = 0;
+  for(i = 0; i < n; i++){
+    pfd[i].revents = 0;
+    if(pfd[i].fd < 0)
+      continue;
+    if((f = fdfile(pfd[i].fd)) == 0)
+      pfd[i].revents = POLLNVAL;
+    else {
+      pfd[i].revents = filepoll(f) & (pfd[i].events | POLLHUP);
+      fileclose(f);
+    }
+    if(pfd[i].revents)
+      nready++;
+  }
+  return nready;
+}
+
+// Wait until some of the n struct pollfds at user address
+// addr are ready, or for timeout ticks if timeout >= 0.
+// Returns the number ready, 0 on timeout, or -1.
+int
+poll(uint64 addr, int n, int timeout)
+{
+  struct pollfd pfd[NOFILE];
+  struct proc *p = myproc();
+  uint seq, t0;
+  int nready;
+
+  if(n < 0 || n > NOFILE)
+    return -1;
+  if(copyin(p->pagetable, (char*)pfd, addr, n*sizeof(pfd[0])) < 0)
+    return -1;
+
+  acquire(&tickslock);
+  t0 = ticks;
+  release(&tickslock);
+
+  acquire(&pollq.lock);
+  pollq.npoll++;
+  if(timeout > 0)
+    pollq.ntimed++;
+  release(&pollq.lock);
+
+  for(;;){
+    acquire(&pollq.lock);
+    seq = pollq.seq;
+    release(&pollq.lock);
+
+    nready = pollscan(pfd, n);
+    if(nready > 0 || timeout == 0 || p->killed)
+      break;
+    if(timeout > 0 && ticks - t0 >= timeout)
+      break;
+
+    // sleep unless something happened since we looked.
+    acquire(&pollq.lock);
+    if(pollq.seq == seq)
+      sleep(&pollq.seq, &pollq.lock);
+    release(&pollq.lock);
+  }
+
+  acquire(&pollq.lock);
+  pollq.npoll--;
+  if(timeout > 0)
+    pollq.ntimed--;
+  release(&pollq.lock);
+
+  if(p->killed)
+    return -1;
+  if(copyout(p->pagetable, addr, (char*)pfd, n*sizeof(pfd[0])) < 0)
+    return -1;
+  return nready;
+}
@@ -0,0 +1,11 @@
+// poll() requests and results, one per file descriptor.
+struct pollfd {
+  int fd;
+  short events;     // what to wait for
+  short revents;    // what is ready, set by poll()
+};
+
+#define POLLIN    0x001   // read() would not block
+#define POLLOUT   0x004   // write() would not block
+#define POLLHUP   0x010   // the other end of a pipe is closed
+#define POLLNVAL  0x020   // fd is not open
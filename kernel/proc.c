@@ -4,20 +4,52 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
 #include "defs.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
 
 struct cpu cpus[NCPU];
 
 struct proc proc[NPROC];
 
+// address spaces; each has a reference from every thread using it.
+struct vmspace vmspaces[NPROC];
+
 struct proc *initproc;
 
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// map from pid to proc, for kill(); chained through
+// p->pidnext and protected by pid_lock.
+#define NPIDHASH NPROC
+struct proc *pidhash[NPIDHASH];
+
+// helps ensure that wakeups of wait()ing
+// parents are not lost. protects p->parent
+// and the p->children lists.
+// must be acquired before any p->lock.
+struct spinlock wait_lock;
+
+// number of SCHED_FIFO processes, so that scheduler()
+// can skip looking for them when there are none.
+int nrtproc;
+
+// orders SCHED_FIFO processes of equal priority.
+uint64 rtseq;
+
 extern void forkret(void);
+static void kthreadstart(void);
+static void freepagetable(void*);
+
+// address spaces at least this big are freed by a worker.
+#define BIGFREE (64*PGSIZE)
 static void wakeup1(struct proc *chan);
 static void freeproc(struct proc *p);
+static void vmspaceput(struct proc *p);
+static void setrunnable(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
 
@@ -26,8 +58,10 @@ void
 procinit(void)
 {
   struct proc *p;
+  struct vmspace *vm;
   
   initlock(&pid_lock, "nextpid");
+  initlock(&wait_lock, "wait_lock");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
 
@@ -41,6 +75,8 @@ procinit(void)
       kvmmap(va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
       p->kstack = va;
   }
+  for(vm = vmspaces; vm < &vmspaces[NPROC]; vm++)
+    initlock(&vm->lock, "vmspace");
   kvminithart();
 }
 
@@ -85,6 +121,52 @@ allocpid() {
   return pid;
 }
 
+// Enter p in the pid hash table.
+static void
+pidhash_add(struct proc *p)
+{
+  struct proc **pp = &pidhash[p->pid % NPIDHASH];
+
+  acquire(&pid_lock);
+  p->pidnext = *pp;
+  *pp = p;
+  release(&pid_lock);
+}
+
+// Remove p from the pid hash table, if it is there.
+static void
+pidhash_remove(struct proc *p)
+{
+  struct proc **pp;
+
+  acquire(&pid_lock);
+  for(pp = &pidhash[p->pid % NPIDHASH]; *pp; pp = &(*pp)->pidnext){
+    if(*pp == p){
+      *pp = p->pidnext;
+      break;
+    }
+  }
+  p->pidnext = 0;
+  release(&pid_lock);
+}
+
+// Return the proc with the given pid, or 0.
+// The proc is not locked, and may be freed and reused
+// before the caller locks it, so the caller must lock
+// it and check p->pid again.
+static struct proc*
+pidlookup(int pid)
+{
+  struct proc *p;
+
+  acquire(&pid_lock);
+  for(p = pidhash[pid % NPIDHASH]; p; p = p->pidnext)
+    if(p->pid == pid)
+      break;
+  release(&pid_lock);
+  return p;
+}
+
 // Look in the process table for an UNUSED proc.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
@@ -106,6 +188,7 @@ allocproc(void)
 
 found:
   p->pid = allocpid();
+  p->affinity = -1;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -113,20 +196,15 @@ found:
     return 0;
   }
 
-  // An empty user page table.
-  p->pagetable = proc_pagetable(p);
-  if(p->pagetable == 0){
-    freeproc(p);
-    release(&p->lock);
-    return 0;
-  }
-
   // Set up new context to start executing at forkret,
   // which returns to user space.
   memset(&p->context, 0, sizeof(p->context));
   p->context.ra = (uint64)forkret;
   p->context.sp = p->kstack + PGSIZE;
 
+  pidhash_add(p);
+  p->state = USED;
+
   return p;
 }
 
@@ -136,22 +214,98 @@ found:
 static void
 freeproc(struct proc *p)
 {
+  if(p->vm)
+    vmspaceput(p);
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
-  if(p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
-  p->pagetable = 0;
-  p->sz = 0;
+  if(p->pid)
+    pidhash_remove(p);
   p->pid = 0;
   p->parent = 0;
+  p->children = 0;
+  p->sibling = 0;
   p->name[0] = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  p->yieldto = 0;
+  p->tracemask = 0;
+  if(p->policy == SCHED_FIFO)
+    __sync_fetch_and_add(&nrtproc, -1);
+  p->policy = SCHED_OTHER;
+  p->rtprio = 0;
+  p->affinity = -1;
+  p->kfn = 0;
+  p->karg = 0;
+  memset(&p->acct, 0, sizeof(p->acct));
+  p->utime = 0;
+  p->stime = 0;
   p->state = UNUSED;
 }
 
+// Give p a new address space, with no user memory.
+// Returns 0, or -1 if out of memory.
+static int
+vmspacealloc(struct proc *p)
+{
+  struct vmspace *vm;
+
+  for(vm = vmspaces; vm < &vmspaces[NPROC]; vm++) {
+    acquire(&vm->lock);
+    if(vm->ref == 0)
+      goto found;
+    release(&vm->lock);
+  }
+  return -1;
+
+found:
+  if((vm->pagetable = proc_pagetable(p)) == 0){
+    release(&vm->lock);
+    return -1;
+  }
+  vm->ref = 1;
+  vm->threads = 1;
+  vm->sz = 0;
+  release(&vm->lock);
+
+  p->vm = vm;
+  p->pagetable = vm->pagetable;
+  p->thread = 0;
+  return 0;
+}
+
+// Drop p's reference to its address space, unmapping
+// p's trapframe, and free the address space if p was
+// the last thread using it.
+static void
+vmspaceput(struct proc *p)
+{
+  struct vmspace *vm = p->vm;
+  pagetable_t pagetable;
+  uint64 sz;
+
+  acquire(&vm->lock);
+  uvmunmap(vm->pagetable, TRAPFRAMEN(p->thread), 1, 0);
+  vm->threads &= ~(1 << p->thread);
+  if(--vm->ref > 0){
+    release(&vm->lock);
+  } else {
+    pagetable = vm->pagetable;
+    sz = vm->sz;
+    if(vm->ioring)
+      uvmunmap(pagetable, IORING, 1, 1);
+    vm->pagetable = 0;
+    vm->sz = 0;
+    vm->ioring = 0;
+    release(&vm->lock);
+    proc_freepagetable(pagetable, sz);
+  }
+  p->vm = 0;
+  p->pagetable = 0;
+  p->thread = 0;
+}
+
 // Create a user page table for a given process,
 // with no user memory, but with trampoline pages.
 pagetable_t
@@ -182,19 +336,44 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the clock page just below the trapframe, readable
+  // by user code.
+  if(mappages(pagetable, UCLOCK, PGSIZE,
+              (uint64)uclockpage, PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
 // Free a process's page table, and free the
-// physical memory it refers to.
+// physical memory it refers to. The caller must
+// already have unmapped the trapframes.
 void
 proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
-  uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, UCLOCK, 1, 0);
+  // freeing a big address space takes a while, and the
+  // caller (wait() or exec()) may hold locks; leave it
+  // to a worker thread. but when fewer pages are free than
+  // it holds, free it now: only growproc() waits for the
+  // worker before failing, and fork() or exec() would not.
+  if(sz >= BIGFREE && kfreepages() >= sz / PGSIZE &&
+     queue_work(freepagetable, pagetable) == 0)
+    return;
   uvmfree(pagetable, sz);
 }
 
+static void
+freepagetable(void *pagetable)
+{
+  uvmfreeall((pagetable_t)pagetable);
+}
+
 // a user program that calls exec("/init")
 // od -t xC initcode
 uchar initcode[] = {
@@ -207,49 +386,108 @@ uchar initcode[] = {
   0x00, 0x00, 0x00, 0x00
 };
 
-// Set up first user process.
-void
-userinit(void)
+// Mount the root file system and set up the first user
+// process. Runs on a worker thread, since file system
+// initialization sleeps and so needs a process context.
+static void
+initfirst(void *arg)
 {
   struct proc *p;
 
+  fsinit(ROOTDEV);
+
   p = allocproc();
+  if(p == 0 || vmspacealloc(p) < 0 || (p->files = filesalloc()) == 0)
+    panic("initfirst");
   initproc = p;
   
   // allocate one user page and copy init's instructions
   // and data into it.
   uvminit(p->pagetable, initcode, sizeof(initcode));
-  p->sz = PGSIZE;
+  p->vm->sz = PGSIZE;
 
   // prepare for the very first "return" from kernel to user.
   p->trapframe->epc = 0;      // user program counter
   p->trapframe->sp = PGSIZE;  // user stack pointer
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
-  p->cwd = namei("/");
+  p->files->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setrunnable(p);
+
+  release(&p->lock);
+}
+
+// Set up first user process.
+void
+userinit(void)
+{
+  if(queue_work(initfirst, 0) < 0)
+    panic("userinit");
+}
+
+// Create a kernel thread called name, which runs fn(arg)
+// entirely in the kernel, on hart cpu or on any hart if
+// cpu is -1. fn must never return.
+// Returns the new thread, or 0 if out of memory or procs.
+struct proc*
+kthread(char *name, void (*fn)(void*), void *arg, int cpu)
+{
+  struct proc *p;
 
+  if((p = allocproc()) == 0)
+    return 0;
+
+  // it has no user memory.
+  kfree((void*)p->trapframe);
+  p->trapframe = 0;
+
+  p->context.ra = (uint64)kthreadstart;
+  p->kfn = fn;
+  p->karg = arg;
+  p->affinity = cpu;
+  safestrcpy(p->name, name, sizeof(p->name));
+  setrunnable(p);
   release(&p->lock);
+  return p;
 }
 
-// Grow or shrink user memory by n bytes.
+// Grow or shrink user memory by n bytes, setting
+// *oldsz to the size before.
 // Return 0 on success, -1 on failure.
 int
-growproc(int n)
+growproc(int n, uint64 *oldsz)
 {
-  uint sz;
-  struct proc *p = myproc();
-
-  sz = p->sz;
+  uint64 sz;
+  struct vmspace *vm = myproc()->vm;
+  int flushed = 0;
+
+again:
+  acquire(&vm->lock);
+  sz = vm->sz;
+  *oldsz = sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
-      return -1;
+    if((sz = uvmalloc(vm->pagetable, sz, sz + n)) == 0) {
+      release(&vm->lock);
+      if(flushed)
+        return -1;
+      // memory of exited processes may still be on its way
+      // back to the free list; see proc_freepagetable().
+      flush_work();
+      flushed = 1;
+      goto again;
     }
   } else if(n < 0){
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
+    // other harts running our threads may still have the
+    // pages in their TLBs.
+    if(vm->ref > 1){
+      release(&vm->lock);
+      return -1;
+    }
+    sz = uvmdealloc(vm->pagetable, sz, sz + n);
   }
-  p->sz = sz;
+  vm->sz = sz;
+  release(&vm->lock);
   return 0;
 }
 
@@ -258,7 +496,7 @@ growproc(int n)
 int
 fork(void)
 {
-  int i, pid;
+  int pid;
   struct proc *np;
   struct proc *p = myproc();
 
@@ -268,14 +506,26 @@ fork(void)
   }
 
   // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+  if(vmspacealloc(np) < 0){
     freeproc(np);
     release(&np->lock);
     return -1;
   }
-  np->sz = p->sz;
+  acquire(&p->vm->lock);
+  if(uvmcopy(p->pagetable, np->pagetable, p->vm->sz) < 0){
+    release(&p->vm->lock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  np->vm->sz = p->vm->sz;
+  release(&p->vm->lock);
 
-  np->parent = p;
+  if((np->files = filescopy(p->files)) == 0){
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -283,47 +533,125 @@ fork(void)
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
 
-  // increment reference counts on open file descriptors.
-  for(i = 0; i < NOFILE; i++)
-    if(p->ofile[i])
-      np->ofile[i] = filedup(p->ofile[i]);
-  np->cwd = idup(p->cwd);
+  safestrcpy(np->name, p->name, sizeof(p->name));
+  np->tracemask = p->tracemask;
+
+  // the scheduling class is inherited.
+  np->policy = p->policy;
+  np->rtprio = p->rtprio;
+  if(np->policy == SCHED_FIFO)
+    __sync_fetch_and_add(&nrtproc, 1);
+
+  pid = np->pid;
+
+  // np is USED until setrunnable(), so no allocproc() can
+  // take it while it is unlocked.
+  release(&np->lock);
+
+  acquire(&wait_lock);
+  np->parent = p;
+  np->sibling = p->children;
+  p->children = np;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  setrunnable(np);
+  release(&np->lock);
+
+  return pid;
+}
+
+// Create a new thread that shares the caller's address
+// space, open files and current directory, and starts in
+// user space at fn(arg) on the given stack.
+// The caller collects it with join(); it is its child.
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int t, pid;
+  struct proc *np;
+  struct proc *p = myproc();
+  struct vmspace *vm = p->vm;
+
+  if((np = allocproc()) == 0){
+    return -1;
+  }
+
+  // map np's trapframe in a free slot of our address space.
+  acquire(&vm->lock);
+  for(t = 0; t < NTHREAD; t++)
+    if((vm->threads & (1 << t)) == 0)
+      break;
+  if(t == NTHREAD || mappages(vm->pagetable, TRAPFRAMEN(t), PGSIZE,
+                              (uint64)np->trapframe, PTE_R | PTE_W) < 0){
+    release(&vm->lock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  vm->threads |= 1 << t;
+  vm->ref++;
+  release(&vm->lock);
+  np->vm = vm;
+  np->pagetable = vm->pagetable;
+  np->thread = t;
+
+  np->files = filesdup(p->files);
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->sp = stack;
+  np->trapframe->a0 = arg;
 
   safestrcpy(np->name, p->name, sizeof(p->name));
+  np->tracemask = p->tracemask;
+
+  np->policy = p->policy;
+  np->rtprio = p->rtprio;
+  if(np->policy == SCHED_FIFO)
+    __sync_fetch_and_add(&nrtproc, 1);
 
   pid = np->pid;
 
-  np->state = RUNNABLE;
+  // np is USED until setrunnable(), as in fork().
+  release(&np->lock);
+
+  acquire(&wait_lock);
+  np->parent = p;
+  np->sibling = p->children;
+  p->children = np;
+  release(&wait_lock);
 
+  acquire(&np->lock);
+  setrunnable(np);
   release(&np->lock);
 
   return pid;
 }
 
 // Pass p's abandoned children to init.
-// Caller must hold p->lock.
+// Caller must hold wait_lock.
 void
 reparent(struct proc *p)
 {
-  struct proc *pp;
-
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    // this code uses pp->parent without holding pp->lock.
-    // acquiring the lock first could cause a deadlock
-    // if pp or a child of pp were also in exit()
-    // and about to try to lock p.
-    if(pp->parent == p){
-      // pp->parent can't change between the check and the acquire()
-      // because only the parent changes it, and we're the parent.
-      acquire(&pp->lock);
-      pp->parent = initproc;
-      // we should wake up init here, but that would require
-      // initproc->lock, which would be a deadlock, since we hold
-      // the lock on one of init's children (pp). this is why
-      // exit() always wakes init (before acquiring any locks).
-      release(&pp->lock);
-    }
+  struct proc *pp, *last;
+
+  if(p->children == 0)
+    return;
+
+  last = 0;
+  for(pp = p->children; pp; pp = pp->sibling){
+    pp->parent = initproc;
+    last = pp;
   }
+  last->sibling = initproc->children;
+  initproc->children = p->children;
+  p->children = 0;
+
+  // some of them may already be zombies.
+  acquire(&initproc->lock);
+  wakeup1(initproc);
+  release(&initproc->lock);
 }
 
 // Exit the current process.  Does not return.
@@ -337,119 +665,224 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for(int fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd]){
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
-    }
-  }
+  // Close all open files, unless other threads still use them.
+  filesput(p->files);
+  p->files = 0;
 
-  begin_op();
-  iput(p->cwd);
-  end_op();
-  p->cwd = 0;
-
-  // we might re-parent a child to init. we can't be precise about
-  // waking up init, since we can't acquire its lock once we've
-  // acquired any other proc lock. so wake up init whether that's
-  // necessary or not. init may miss this wakeup, but that seems
-  // harmless.
-  acquire(&initproc->lock);
-  wakeup1(initproc);
-  release(&initproc->lock);
-
-  // grab a copy of p->parent, to ensure that we unlock the same
-  // parent we locked. in case our parent gives us away to init while
-  // we're waiting for the parent lock. we may then race with an
-  // exiting parent, but the result will be a harmless spurious wakeup
-  // to a dead or wrong process; proc structs are never re-allocated
-  // as anything else.
-  acquire(&p->lock);
-  struct proc *original_parent = p->parent;
-  release(&p->lock);
-  
-  // we need the parent's lock in order to wake it up from wait().
-  // the parent-then-child rule says we have to lock it first.
-  acquire(&original_parent->lock);
-
-  acquire(&p->lock);
+  acquire(&wait_lock);
 
   // Give any children to init.
   reparent(p);
 
   // Parent might be sleeping in wait().
-  wakeup1(original_parent);
+  acquire(&p->parent->lock);
+  wakeup1(p->parent);
+  release(&p->parent->lock);
+
+  acquire(&p->lock);
 
   p->xstate = status;
   p->state = ZOMBIE;
 
-  release(&original_parent->lock);
+  release(&wait_lock);
 
   // Jump into the scheduler, never to return.
   sched();
   panic("zombie exit");
 }
 
-// Wait for a child process to exit and return its pid.
-// Return -1 if this process has no children.
-int
-wait(uint64 addr)
+// Wait for a child to exit and return its pid. If threads
+// is set, only for children sharing our address space, as
+// clone() makes; otherwise only for other children.
+// Return -1 if this process has no such children.
+static int
+waitchild(uint64 addr, int threads)
 {
-  struct proc *np;
+  struct proc *np, **pp;
   int havekids, pid;
   struct proc *p = myproc();
 
-  // hold p->lock for the whole time to avoid lost
+  // hold wait_lock for the whole time to avoid lost
   // wakeups from a child's exit().
-  acquire(&p->lock);
+  acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
+    // Scan through our children looking for exited ones.
     havekids = 0;
-    for(np = proc; np < &proc[NPROC]; np++){
-      // this code uses np->parent without holding np->lock.
-      // acquiring the lock first would cause a deadlock,
-      // since np might be an ancestor, and we already hold p->lock.
-      if(np->parent == p){
-        // np->parent can't change between the check and the acquire()
-        // because only the parent changes it, and we're the parent.
-        acquire(&np->lock);
-        havekids = 1;
-        if(np->state == ZOMBIE){
-          // Found one.
-          pid = np->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&p->lock);
-            return -1;
-          }
-          freeproc(np);
+    for(pp = &p->children; (np = *pp) != 0; pp = &np->sibling){
+      if((np->vm == p->vm) != threads)
+        continue;
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&np->lock);
+      havekids = 1;
+      if(np->state == ZOMBIE){
+        // Found one.
+        pid = np->pid;
+        if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                                sizeof(np->xstate)) < 0) {
           release(&np->lock);
-          release(&p->lock);
-          return pid;
+          release(&wait_lock);
+          return -1;
         }
+        *pp = np->sibling;
+        freeproc(np);
         release(&np->lock);
+        release(&wait_lock);
+        return pid;
       }
+      release(&np->lock);
     }
 
     // No point waiting if we don't have any children.
     if(!havekids || p->killed){
-      release(&p->lock);
+      release(&wait_lock);
       return -1;
     }
     
     // Wait for a child to exit.
-    sleep(p, &p->lock);  //DOC: wait-sleep
+    sleep(p, &wait_lock);  //DOC: wait-sleep
+  }
+}
+
+int
+wait(uint64 addr)
+{
+  return waitchild(addr, 0);
+}
+
+// Wait for a thread made by clone() to exit.
+int
+join(uint64 addr)
+{
+  return waitchild(addr, 1);
+}
+
+// Add an interval of d mtime cycles to log2 histogram h,
+// in microseconds.
+static void
+histadd(uint64 *h, uint64 d)
+{
+  int i;
+
+  d /= MTIME_HZ / 1000000;
+  for(i = 0; d != 0 && i < NSCHEDHIST-1; i++)
+    d >>= 1;
+  h[i]++;
+}
+
+// Account for a wait of d cycles while RUNNABLE.
+static void
+acctwait(struct schedacct *a, uint64 d)
+{
+  a->waittime += d;
+  if(d > a->maxwait)
+    a->maxwait = d;
+  histadd(a->waithist, d);
+}
+
+// Account for a time slice of d cycles.
+static void
+acctslice(struct schedacct *a, uint64 d)
+{
+  a->runtime += d;
+  histadd(a->slicehist, d);
+}
+
+// May p run on hart c?
+static int
+runson(struct cpu *c, struct proc *p)
+{
+  return p->affinity < 0 || p->affinity == c - cpus;
+}
+
+// Switch to p, which must be locked and RUNNABLE, and
+// return when it gives up the CPU.
+static void
+runproc(struct cpu *c, struct proc *p)
+{
+  uint64 now;
+
+  now = readmtime();
+  acctwait(&p->acct, now - p->tstamp);
+  acctwait(&c->acct, now - p->tstamp);
+  p->tstamp = now;
+
+  // Switch to chosen process.  It is the process's job
+  // to release its lock and then reacquire it
+  // before jumping back to us.
+  p->state = RUNNING;
+  cpumode(CPU_KERNEL);
+  c->proc = p;
+  swtch(&c->context, &p->context);
+
+  // Process is done running for now.
+  // It should have changed its p->state before coming back.
+  cpumode(CPU_KERNEL);
+  c->proc = 0;
+}
+
+// Return the highest-priority RUNNABLE SCHED_FIFO process,
+// the one that became runnable first among equals, with
+// its lock held. Return 0 if there is none.
+static struct proc*
+pickrt(struct cpu *c)
+{
+  struct proc *p, *best;
+
+  for(;;){
+    // look without locks, then check the choice under its lock.
+    best = 0;
+    for(p = proc; p < &proc[NPROC]; p++){
+      if(p->state != RUNNABLE || p->policy != SCHED_FIFO || !runson(c, p))
+        continue;
+      if(best == 0 || p->rtprio > best->rtprio ||
+         (p->rtprio == best->rtprio && p->rtseq < best->rtseq))
+        best = p;
+    }
+    if(best == 0)
+      return 0;
+    acquire(&best->lock);
+    if(best->state == RUNNABLE && best->policy == SCHED_FIFO)
+      return best;
+    release(&best->lock);
+  }
+}
+
+// If the process that just ran went to sleep right after
+// waking a single peer (see wakeup_directed()), run the peer
+// now on this CPU instead of leaving it to whichever
+// scheduler happens to find it first. A RUNNABLE SCHED_FIFO
+// process still comes first, unless it is the peer.
+static void
+directedyield(struct cpu *c)
+{
+  struct proc *p, *q;
+
+  while((p = c->yieldto) != 0){
+    c->yieldto = 0;
+    if(c->resched)
+      break;
+    if(nrtproc > 0 && (q = pickrt(c)) != 0){
+      if(q != p){
+        release(&q->lock);
+        c->resched = 1;  // back to scheduler() to run q
+        break;
+      }
+    } else {
+      acquire(&p->lock);
+    }
+    if(p->state == RUNNABLE && runson(c, p))
+      runproc(c, p);
+    release(&p->lock);
   }
 }
 
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
+//  - choose a process to run: a SCHED_FIFO process if
+//    any is runnable, otherwise the next runnable
+//    SCHED_OTHER process in round-robin order.
 //  - swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
@@ -460,32 +893,41 @@ scheduler(void)
   struct cpu *c = mycpu();
   
   c->proc = 0;
+  c->mode = CPU_KERNEL;
+  c->mstamp = readmtime();
+  c->started = 1;
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
+
+    rcu_quiescent();
+    c->resched = 0;
+    if(nrtproc > 0 && (p = pickrt(c)) != 0){
+      runproc(c, p);
+      release(&p->lock);
+      directedyield(c);
+      continue;
+    }
     
     int found = 0;
     for(p = proc; p < &proc[NPROC]; p++) {
       acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-
+      if(p->state == RUNNABLE && p->policy == SCHED_OTHER && runson(c, p)) {
+        runproc(c, p);
         found = 1;
       }
       release(&p->lock);
+      directedyield(c);
+
+      // a SCHED_FIFO process has become runnable.
+      if(c->resched)
+        break;
     }
-    if(found == 0) {
+    if(found == 0 && c->resched == 0) {
       intr_on();
+      cpumode(CPU_IDLE);
       asm volatile("wfi");
+      cpumode(CPU_KERNEL);
     }
   }
 }
@@ -501,6 +943,7 @@ void
 sched(void)
 {
   int intena;
+  uint64 now;
   struct proc *p = myproc();
 
   if(!holding(&p->lock))
@@ -512,11 +955,37 @@ sched(void)
   if(intr_get())
     panic("sched interruptible");
 
+  now = readmtime();
+  acctslice(&p->acct, now - p->tstamp);
+  acctslice(&mycpu()->acct, now - p->tstamp);
+  p->tstamp = now;
+
   intena = mycpu()->intena;
   swtch(&p->context, &mycpu()->context);
   mycpu()->intena = intena;
 }
 
+// Called on the way out of a trap. Give up the CPU if this
+// was a timer interrupt, unless we are SCHED_FIFO (which is
+// never time-sliced), or if a SCHED_FIFO process of higher
+// priority than ours has become runnable.
+void
+preempt(int tick)
+{
+  struct proc *p = myproc();
+  struct cpu *c;
+  int resched;
+
+  push_off();
+  c = mycpu();
+  resched = c->resched;
+  c->resched = 0;
+  pop_off();
+
+  if(resched || (tick && p->policy != SCHED_FIFO))
+    yield();
+}
+
 // Give up the CPU for one scheduling round.
 void
 yield(void)
@@ -524,6 +993,8 @@ yield(void)
   struct proc *p = myproc();
   acquire(&p->lock);
   p->state = RUNNABLE;
+  p->acct.nivcsw++;
+  mycpu()->acct.nivcsw++;
   sched();
   release(&p->lock);
 }
@@ -533,22 +1004,26 @@ yield(void)
 void
 forkret(void)
 {
-  static int first = 1;
-
   // Still holding p->lock from scheduler.
   release(&myproc()->lock);
 
-  if (first) {
-    // File system initialization must be run in the context of a
-    // regular process (e.g., because it calls sleep), and thus cannot
-    // be run from main().
-    first = 0;
-    fsinit(ROOTDEV);
-  }
-
   usertrapret();
 }
 
+// A kernel thread's first scheduling by scheduler()
+// will swtch here.
+static void
+kthreadstart(void)
+{
+  struct proc *p = myproc();
+
+  // Still holding p->lock from scheduler.
+  release(&p->lock);
+
+  p->kfn(p->karg);
+  panic("kthread returned");
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
@@ -571,6 +1046,12 @@ sleep(void *chan, struct spinlock *lk)
   p->chan = chan;
   p->state = SLEEPING;
 
+  // Hand this CPU to the peer we just woke, if any.
+  mycpu()->yieldto = p->yieldto;
+  p->yieldto = 0;
+  p->acct.nvcsw++;
+  mycpu()->acct.nvcsw++;
+
   sched();
 
   // Tidy up.
@@ -583,6 +1064,64 @@ sleep(void *chan, struct spinlock *lk)
   }
 }
 
+// Priority of what c is running, for setrunnable():
+// -2 if idle, -1 for SCHED_OTHER, else the rtprio.
+static int
+cpuprio(struct cpu *c)
+{
+  // c->proc may change under us; this is only a hint.
+  struct proc *q = c->proc;
+
+  if(q == 0)
+    return -2;
+  if(q->policy != SCHED_FIFO)
+    return -1;
+  return q->rtprio;
+}
+
+// Mark p RUNNABLE after sleeping or being created.
+// A SCHED_FIFO process goes behind others of its priority,
+// and one CPU that may run it is asked to reschedule at its
+// next trap: an idle one if any, otherwise the one running
+// the lowest-priority process, if that is below p's.
+// Caller must hold p->lock.
+static void
+setrunnable(struct proc *p)
+{
+  struct cpu *c, *best;
+  int prio, bestprio;
+
+  p->state = RUNNABLE;
+  p->tstamp = readmtime();
+  if(p->policy != SCHED_FIFO)
+    return;
+  p->rtseq = __sync_fetch_and_add(&rtseq, 1);
+  best = 0;
+  bestprio = p->rtprio;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->started || !runson(c, p))
+      continue;
+    if((prio = cpuprio(c)) < bestprio){
+      best = c;
+      bestprio = prio;
+    }
+  }
+  if(best)
+    best->resched = 1;
+}
+
+// Wake p if it is sleeping on chan. Cheaper than wakeup()
+// when the sleeper is known, and may be called holding the
+// locks of processes other than p.
+void
+wakeupproc(struct proc *p, void *chan)
+{
+  acquire(&p->lock);
+  if(p->state == SLEEPING && p->chan == chan)
+    setrunnable(p);
+  release(&p->lock);
+}
+
 // Wake up all processes sleeping on chan.
 // Must be called without any p->lock.
 void
@@ -593,10 +1132,36 @@ wakeup(void *chan)
   for(p = proc; p < &proc[NPROC]; p++) {
     acquire(&p->lock);
     if(p->state == SLEEPING && p->chan == chan) {
-      p->state = RUNNABLE;
+      setrunnable(p);
+    }
+    release(&p->lock);
+  }
+}
+
+// Like wakeup(), for synchronous IPC such as pipes: if exactly
+// one process was woken, remember it so that the caller's next
+// sleep() switches straight to it on the same CPU (a directed
+// yield) instead of waiting for some CPU to pick it up.
+// Must be called without any p->lock, from process context.
+void
+wakeup_directed(void *chan)
+{
+  struct proc *p, *peer;
+  struct proc *me = myproc();
+  int n;
+
+  n = 0;
+  peer = 0;
+  for(p = proc; p < &proc[NPROC]; p++) {
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan) {
+      setrunnable(p);
+      peer = p;
+      n++;
     }
     release(&p->lock);
   }
+  me->yieldto = (n == 1) ? peer : 0;
 }
 
 // Wake up p if it is sleeping in wait(); used by exit().
@@ -607,7 +1172,7 @@ wakeup1(struct proc *p)
   if(!holding(&p->lock))
     panic("wakeup1");
   if(p->chan == p && p->state == SLEEPING) {
-    p->state = RUNNABLE;
+    setrunnable(p);
   }
 }
 
@@ -619,20 +1184,72 @@ kill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
+  if((p = pidlookup(pid)) == 0)
+    return -1;
+  acquire(&p->lock);
+  if(p->pid != pid){
+    // freed (and maybe reused) since the lookup.
     release(&p->lock);
+    return -1;
   }
-  return -1;
+  if(p->kfn){
+    // kernel threads cannot be killed.
+    release(&p->lock);
+    return -1;
+  }
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    setrunnable(p);
+  }
+  release(&p->lock);
+  return 0;
+}
+
+// Set the scheduling class and static priority of the process
+// with the given pid, or of the caller if pid is 0.
+// Returns 0, or -1 if there is no such process or the
+// class or priority is invalid.
+int
+setscheduler(int pid, int policy, int prio)
+{
+  struct proc *p;
+
+  if(policy == SCHED_OTHER){
+    if(prio != 0)
+      return -1;
+  } else if(policy == SCHED_FIFO){
+    if(prio < 1 || prio > SCHED_MAXPRIO)
+      return -1;
+  } else {
+    return -1;
+  }
+
+  if(pid == 0)
+    pid = myproc()->pid;
+  if((p = pidlookup(pid)) == 0)
+    return -1;
+  acquire(&p->lock);
+  if(p->pid != pid){
+    release(&p->lock);
+    return -1;
+  }
+  if(p->policy != policy)
+    __sync_fetch_and_add(&nrtproc, policy == SCHED_FIFO ? 1 : -1);
+  p->policy = policy;
+  p->rtprio = prio;
+  if(p->state == RUNNABLE)
+    setrunnable(p);
+  release(&p->lock);
+
+  // we may have lowered our own priority below that of a
+  // runnable process; let the scheduler decide.
+  if(p == myproc()){
+    push_off();
+    mycpu()->resched = 1;
+    pop_off();
+  }
+  return 0;
 }
 
 // Copy to either a user address, or kernel address,
@@ -676,10 +1293,13 @@ procdump(void)
   [SLEEPING]  "sleep ",
   [RUNNABLE]  "runble",
   [RUNNING]   "run   ",
-  [ZOMBIE]    "zombie"
+  [ZOMBIE]    "zombie",
+  [USED]      "used  "
   };
   struct proc *p;
+  struct cpu *c;
   char *state;
+  int scale = MTIME_HZ / 1000000;
 
   printf("\n");
   for(p = proc; p < &proc[NPROC]; p++){
@@ -690,6 +1310,98 @@ procdump(void)
     else
       state = "???";
     printf("%d %s %s", p->pid, state, p->name);
+    printf(" vcsw %d ivcsw %d run %dus wait %dus max %dus",
+           (int)p->acct.nvcsw, (int)p->acct.nivcsw,
+           (int)(p->acct.runtime / scale), (int)(p->acct.waittime / scale),
+           (int)(p->acct.maxwait / scale));
     printf("\n");
   }
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->started)
+      continue;
+    printf("hart %d vcsw %d ivcsw %d run %dus wait %dus max %dus\n",
+           (int)(c - cpus), (int)c->acct.nvcsw, (int)c->acct.nivcsw,
+           (int)(c->acct.runtime / scale), (int)(c->acct.waittime / scale),
+           (int)(c->acct.maxwait / scale));
+  }
+}
+
+// Convert scheduler statistics from mtime cycles for user space.
+static void
+schedstat(struct schedstat *s, struct schedacct *a)
+{
+  int i, scale = MTIME_HZ / 1000000;
+
+  s->nvcsw = a->nvcsw;
+  s->nivcsw = a->nivcsw;
+  s->waittime = a->waittime / scale;
+  s->runtime = a->runtime / scale;
+  s->maxwait = a->maxwait / scale;
+  for(i = 0; i < NSCHEDHIST; i++){
+    s->waithist[i] = a->waithist[i];
+    s->slicehist[i] = a->slicehist[i];
+  }
+}
+
+// Copy scheduler statistics for up to n processes to the
+// user array of struct procstat at addr.
+// Returns the number copied, or -1 on a bad address.
+int
+procstat(uint64 addr, int n)
+{
+  struct proc *p;
+  struct procstat ps;
+  int i = 0;
+
+  for(p = proc; p < &proc[NPROC] && i < n; p++){
+    acquire(&p->lock);
+    // a USED proc is still being set up by fork(), clone()
+    // or kthread().
+    if(p->state == UNUSED || p->state == USED){
+      release(&p->lock);
+      continue;
+    }
+    ps.pid = p->pid;
+    ps.state = p->state;
+    ps.policy = p->policy;
+    ps.rtprio = p->rtprio;
+    safestrcpy(ps.name, p->name, sizeof(ps.name));
+    ps.utime = p->utime / (MTIME_HZ / 1000000);
+    ps.stime = p->stime / (MTIME_HZ / 1000000);
+    schedstat(&ps.s, &p->acct);
+    release(&p->lock);
+    if(copyout(myproc()->pagetable, addr + i*sizeof(ps), (char*)&ps, sizeof(ps)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
+}
+
+// Copy scheduler statistics for up to n running harts to the
+// user array of struct hartstat at addr.
+// Returns the number copied, or -1 on a bad address.
+int
+hartstat(uint64 addr, int n)
+{
+  struct cpu *c;
+  struct proc *p;
+  struct hartstat hs;
+  int i = 0, m;
+
+  for(c = cpus; c < &cpus[NCPU] && i < n; c++){
+    if(!c->started)
+      continue;
+    // another hart updates these as we read them;
+    // the counts are only approximately consistent.
+    hs.hart = c - cpus;
+    p = c->proc;
+    hs.pid = p ? p->pid : 0;
+    for(m = 0; m < NCPUMODE; m++)
+      hs.modetime[m] = c->modetime[m] / (MTIME_HZ / 1000000);
+    schedstat(&hs.s, &c->acct);
+    if(copyout(myproc()->pagetable, addr + i*sizeof(hs), (char*)&hs, sizeof(hs)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
 }
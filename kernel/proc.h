@@ -18,12 +18,32 @@ struct context {
   uint64 s11;
 };
 
+// Scheduler statistics, kept per process and per hart.
+// Times are in CLINT_MTIME cycles.
+struct schedacct {
+  uint64 nvcsw;                 // Voluntary switches, by sleep()
+  uint64 nivcsw;                // Involuntary switches, by yield()
+  uint64 waittime;              // Time spent RUNNABLE
+  uint64 runtime;               // Time spent RUNNING
+  uint64 maxwait;               // Longest single wait while RUNNABLE
+  uint64 waithist[NSCHEDHIST];  // log2 histogram of waits
+  uint64 slicehist[NSCHEDHIST]; // log2 histogram of time slices
+};
+
 // Per-CPU state.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  struct proc *yieldto;       // Run this process next; see wakeup_directed().
+  int resched;                // A higher-priority process became RUNNABLE.
+  int started;                // Has entered scheduler().
+  struct schedacct acct;      // Scheduler statistics for this hart.
+  int mode;                   // CPU_USER, CPU_KERNEL, ...; see cpumode().
+  uint64 mstamp;              // CLINT_MTIME when mode was last charged.
+  uint64 modetime[NCPUMODE];  // Time spent in each mode.
+  uint64 rcuqs;               // Quiescent states passed; see rcu.c.
 };
 
 extern struct cpu cpus[NCPU];
@@ -78,9 +98,33 @@ struct trapframe {
   /* 264 */ uint64 t4;
   /* 272 */ uint64 t5;
   /* 280 */ uint64 t6;
+  /* 288 */ uint64 fastcalls;     // system calls uservec sends to kernel_fast
+  /* 296 */ uint64 kernel_fast;   // fastsyscall()
+};
+
+// A user address space, shared by the threads that
+// clone() creates.
+struct vmspace {
+  struct spinlock lock;
+  int ref;                     // Threads using it
+  uint threads;                // Bitmap of TRAPFRAMEN() slots in use
+  pagetable_t pagetable;       // User page table
+  uint64 sz;                   // Size of process memory (bytes)
+  struct ioring *ioring;       // Mapped at IORING, if ioring_setup() was called
 };
 
-enum procstate { UNUSED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
+// Open file table and current directory of a process,
+// shared by the threads that clone() creates.
+struct files {
+  struct spinlock lock;        // protects ofile[] and cwd
+  int ref;                     // reference count, under filestable.lock
+  struct file *ofile[NOFILE];  // Open files
+  struct inode *cwd;           // Current directory
+};
+
+// USED is a slot taken by allocproc() that is not yet RUNNABLE.
+// It comes last so that procstat()'s numbering stays put.
+enum procstate { UNUSED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE, USED };
 
 // Per-process state
 struct proc {
@@ -88,19 +132,38 @@ struct proc {
 
   // p->lock must be held when using these:
   enum procstate state;        // Process state
-  struct proc *parent;         // Parent process
   void *chan;                  // If non-zero, sleeping on chan
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int affinity;                // Hart to run on, or -1 for any
+  int policy;                  // Scheduling class, SCHED_OTHER or SCHED_FIFO
+  int rtprio;                  // SCHED_FIFO static priority, higher runs first
+  uint64 rtseq;                // When it last became RUNNABLE, for FIFO order
+  uint64 tstamp;               // CLINT_MTIME of last switch in or out
+  struct schedacct acct;       // Scheduler statistics
+  uint64 utime;                // Time in user mode, charged by cpumode()
+  uint64 stime;                // Time in the kernel, charged by cpumode()
+
+  // wait_lock must be held when using these:
+  struct proc *parent;         // Parent process
+  struct proc *children;       // List of our children, through sibling
+  struct proc *sibling;        // Next child of our parent
+
+  // pid_lock must be held when using this:
+  struct proc *pidnext;        // Next in pid hash chain
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
-  uint64 sz;                   // Size of process memory (bytes)
-  pagetable_t pagetable;       // User page table
+  struct vmspace *vm;          // User memory, maybe shared with other threads
+  pagetable_t pagetable;       // User page table, a copy of vm->pagetable
+  int thread;                  // Our trapframe is mapped at TRAPFRAMEN(thread)
   struct trapframe *trapframe; // data page for trampoline.S
   struct context context;      // swtch() here to run process
-  struct file *ofile[NOFILE];  // Open files
-  struct inode *cwd;           // Current directory
+  struct files *files;         // Open files and current directory
+  uint64 tracemask;            // Print calls to syscall i if bit i is set
   char name[16];               // Process name (debugging)
+  struct proc *yieldto;        // Peer to hand the CPU to on our next sleep()
+  void (*kfn)(void*);          // If non-zero, a kernel thread running kfn(karg)
+  void *karg;
 };
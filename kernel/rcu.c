@@ -0,0 +1,111 @@
+// Read-copy-update.
+//
+// Lets readers walk shared data structures without taking
+// locks. A reader brackets its walk with rcu_read_lock() and
+// rcu_read_unlock(), which turn interrupts off, so it cannot
+// sleep or be switched out in between. A writer unlinks an
+// object where new readers can no longer find it, then frees
+// it only after a grace period, by which time every hart has
+// passed through a quiescent state (the scheduler, or a return
+// to user space) and so has finished any walk that might have
+// seen the object.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "rcu.h"
+#include "defs.h"
+
+struct {
+  struct spinlock lock;
+  struct rcuhead *head;  // waiting for a grace period
+  int queued;            // rcuwork() is queued to run them
+} rcu;
+
+void
+rcuinit(void)
+{
+  initlock(&rcu.lock, "rcu");
+}
+
+void
+rcu_read_lock(void)
+{
+  push_off();
+}
+
+void
+rcu_read_unlock(void)
+{
+  pop_off();
+}
+
+// Note that this hart is not in a read-side critical section.
+// Called from the scheduler and on the way back to user space.
+void
+rcu_quiescent(void)
+{
+  mycpu()->rcuqs++;
+}
+
+// Wait until every hart has passed a quiescent state, so that
+// all read-side critical sections that had begun have ended.
+// Sleeps, so must not be called with spinlocks held.
+void
+synchronize_rcu(void)
+{
+  uint64 snap[NCPU];
+  int i;
+
+  for(i = 0; i < NCPU; i++)
+    snap[i] = *(volatile uint64*)&cpus[i].rcuqs;
+  for(i = 0; i < NCPU; i++){
+    if(!cpus[i].started)
+      continue;
+    // idle harts pass through the scheduler at least once
+    // a tick.
+    while(*(volatile uint64*)&cpus[i].rcuqs == snap[i]){
+      acquire(&tickslock);
+      sleep(&ticks, &tickslock);
+      release(&tickslock);
+    }
+  }
+}
+
+// Run the callbacks that were waiting when we started,
+// once it is safe.
+static void
+rcuwork(void *arg)
+{
+  struct rcuhead *h, *next;
+
+  acquire(&rcu.lock);
+  h = rcu.head;
+  rcu.head = 0;
+  rcu.queued = 0;
+  release(&rcu.lock);
+
+  synchronize_rcu();
+  for(; h; h = next){
+    next = h->next;
+    h->fn(h);
+  }
+}
+
+// Call fn(h) after a grace period, from a worker thread.
+// May be called with locks held.
+void
+call_rcu(struct rcuhead *h, void (*fn)(struct rcuhead*))
+{
+  h->fn = fn;
+  acquire(&rcu.lock);
+  h->next = rcu.head;
+  rcu.head = h;
+  // if the queue is full, the next call_rcu() will try again.
+  if(!rcu.queued && queue_work(rcuwork, 0) == 0)
+    rcu.queued = 1;
+  release(&rcu.lock);
+}
@@ -0,0 +1,5 @@
+// Deferred freeing for lock-free readers; see rcu.c.
+struct rcuhead {
+  struct rcuhead *next;
+  void (*fn)(struct rcuhead*);  // called after a grace period
+};
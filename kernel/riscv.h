@@ -248,6 +248,23 @@ r_mcounteren()
   return x;
 }
 
+// Supervisor-mode Counter-Enable
+#define COUNTEREN_TM (1L << 1) // allow reading the time CSR
+
+static inline void 
+w_scounteren(uint64 x)
+{
+  asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+static inline uint64
+r_scounteren()
+{
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r" (x) );
+  return x;
+}
+
 // machine-mode cycle counter
 static inline uint64
 r_time()
@@ -0,0 +1,44 @@
+// Scheduling classes, for setscheduler().
+#define SCHED_OTHER   0   // time-shared round robin (the default)
+#define SCHED_FIFO    1   // real-time: fixed priority, no time slice
+
+#define SCHED_MAXPRIO 99  // SCHED_FIFO priorities run from 1 to this
+
+// What a hart is doing, for CPU time accounting.
+#define CPU_USER      0
+#define CPU_KERNEL    1
+#define CPU_INTR      2   // handling a device or timer interrupt
+#define CPU_IDLE      3   // waiting for an interrupt in scheduler()
+
+// Scheduler statistics, as returned by procstat() and hartstat().
+// Times are in microseconds. Bucket 0 of a histogram counts
+// intervals under 1 us, bucket i > 0 those of at least
+// 2^(i-1) and under 2^i us, and the last bucket everything
+// longer. Needs param.h for NSCHEDHIST.
+struct schedstat {
+  uint64 nvcsw;                 // voluntary switches, by sleep
+  uint64 nivcsw;                // involuntary switches, by preemption
+  uint64 waittime;              // time spent runnable, waiting for a CPU
+  uint64 runtime;               // time spent running
+  uint64 maxwait;               // longest single wait for a CPU
+  uint64 waithist[NSCHEDHIST];  // waits for a CPU
+  uint64 slicehist[NSCHEDHIST]; // time slices
+};
+
+struct procstat {
+  int pid;
+  int state;                    // 1 sleeping, 2 runnable, 3 running, 4 zombie
+  int policy;
+  int rtprio;
+  char name[16];
+  uint64 utime;                 // time in user mode
+  uint64 stime;                 // time in the kernel
+  struct schedstat s;
+};
+
+struct hartstat {
+  int hart;
+  int pid;                      // running now, or 0 if idle
+  uint64 modetime[NCPUMODE];    // time as CPU_USER, CPU_KERNEL, ...
+  struct schedstat s;           // of processes while on this hart
+};
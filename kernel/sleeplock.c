@@ -8,6 +8,11 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "sleeplock.h"
+#include "lockstat.h"
+
+// how long acquiresleep() polls a lock whose holder is running
+// before it gives up and sleeps.
+#define MAXSPIN 100000
 
 void
 initsleeplock(struct sleeplock *lk, char *name)
@@ -15,18 +20,68 @@ initsleeplock(struct sleeplock *lk, char *name)
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->readers = 0;
+  lk->writers = 0;
   lk->pid = 0;
+  lk->owner = 0;
+  lk->class = 0;
+  lk->tacq = 0;
+}
+
+// Wait while the lock's holder is running on another hart,
+// since it will likely release the lock before we could go
+// to sleep and be woken. Returns with lk->lk held, as on
+// entry, and 1 if the lock was let go, or 0 if we gave up.
+static int
+spinonowner(struct sleeplock *lk)
+{
+  struct proc *owner = lk->owner;
+  int i;
+
+  if(owner == 0 || owner == myproc() || owner->state != RUNNING)
+    return 0;
+  release(&lk->lk);
+  // a hint only: owner may change state as we look.
+  for(i = 0; i < MAXSPIN; i++){
+    if(*(volatile uint*)&lk->locked == 0 ||
+       *(struct proc *volatile *)&lk->owner != owner ||
+       *(volatile enum procstate*)&owner->state != RUNNING)
+      break;
+  }
+  acquire(&lk->lk);
+  return lk->locked == 0 || lk->owner != owner;
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
+  uint64 sleeps = 0;
+  int spun = 0, freed;
+
   acquire(&lk->lk);
-  while (lk->locked) {
+  lk->writers++;
+  while (lk->locked || lk->readers) {
+    // spin at most once between sleeps.
+    if(lk->locked && !spun){
+      spun = 1;
+      freed = spinonowner(lk);
+      if(lockstat_on)
+        lockstat_spun(&lk->class, lk->name, LOCK_SLEEP, freed);
+      if(freed)
+        continue;
+    }
+    sleeps++;
     sleep(lk, &lk->lk);
+    spun = 0;
   }
+  lk->writers--;
   lk->locked = 1;
   lk->pid = myproc()->pid;
+  lk->owner = myproc();
+  if(lockstat_on){
+    lockstat_acquired(&lk->class, lk->name, LOCK_SLEEP, sleeps);
+    lk->tacq = readmtime();
+  }
   release(&lk->lk);
 }
 
@@ -34,12 +89,53 @@ void
 releasesleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
+  if(lk->tacq){
+    lockstat_released(lk->class, readmtime() - lk->tacq);
+    lk->tacq = 0;
+  }
   lk->locked = 0;
   lk->pid = 0;
+  lk->owner = 0;
   wakeup(lk);
   release(&lk->lk);
 }
 
+// Acquire lk in shared mode, along with any other readers.
+// Waits while a writer holds the lock or is waiting for it,
+// so that a stream of readers cannot starve writers.
+void
+acquiresleep_shared(struct sleeplock *lk)
+{
+  uint64 sleeps = 0;
+
+  acquire(&lk->lk);
+  while (lk->locked || lk->writers) {
+    sleeps++;
+    sleep(lk, &lk->lk);
+  }
+  if(lk->readers++ == 0 && lockstat_on){
+    lockstat_acquired(&lk->class, lk->name, LOCK_SLEEP, sleeps);
+    lk->tacq = readmtime();
+  }
+  release(&lk->lk);
+}
+
+void
+releasesleep_shared(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  if(lk->readers < 1)
+    panic("releasesleep_shared");
+  if(--lk->readers == 0){
+    if(lk->tacq){
+      lockstat_released(lk->class, readmtime() - lk->tacq);
+      lk->tacq = 0;
+    }
+    wakeup(lk);
+  }
+  release(&lk->lk);
+}
+
 int
 holdingsleep(struct sleeplock *lk)
 {
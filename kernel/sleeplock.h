@@ -1,10 +1,19 @@
 // Long-term locks for processes
+// May be held by one process exclusively, or by any number
+// of processes in shared mode.
 struct sleeplock {
-  uint locked;       // Is the lock held?
+  uint locked;       // Is the lock held exclusively?
+  int readers;       // Number of shared holders.
+  int writers;       // Number waiting for exclusive access.
   struct spinlock lk; // spinlock protecting this sleep lock
   
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+  struct proc *owner; // Process holding lock exclusively
+
+  // For lockstat:
+  struct lockclass *class; // Statistics for locks of this name.
+  uint64 tacq;       // CLINT_MTIME when acquired, if counted.
 };
 
@@ -6,14 +6,22 @@
 #include "spinlock.h"
 #include "riscv.h"
 #include "proc.h"
+#include "lockstat.h"
 #include "defs.h"
 
+// spin this many times per waiter ahead of us before looking
+// at the lock again, to keep waiters from all hammering it.
+#define BACKOFF 50
+
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
-  lk->locked = 0;
+  lk->next = 0;
+  lk->owner = 0;
   lk->cpu = 0;
+  lk->class = 0;
+  lk->tacq = 0;
 }
 
 // Acquire the lock.
@@ -21,16 +29,29 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  uint ticket, ahead;
+  uint64 spins = 0;
+  int i;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
+  // Take a ticket. On RISC-V, sync_fetch_and_add turns into
+  // an atomic add:
   //   a5 = 1
-  //   s1 = &lk->locked
-  //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  //   s1 = &lk->next
+  //   amoadd.w.aqrl a5, a5, (s1)
+  ticket = __sync_fetch_and_add(&lk->next, 1);
+
+  // Wait for our turn, backing off in proportion to the
+  // number of waiters ahead of us, so that only the next
+  // in line polls the lock closely.
+  while((ahead = ticket - *(volatile uint*)&lk->owner) != 0){
+    spins++;
+    for(i = (ahead - 1) * BACKOFF; i > 0; i--)
+      asm volatile("nop");
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,6 +61,11 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+
+  if(lockstat_on){
+    lockstat_acquired(&lk->class, lk->name, LOCK_SPIN, spins);
+    lk->tacq = readmtime();
+  }
 }
 
 // Release the lock.
@@ -49,6 +75,11 @@ release(struct spinlock *lk)
   if(!holding(lk))
     panic("release");
 
+  if(lk->tacq){
+    lockstat_released(lk->class, readmtime() - lk->tacq);
+    lk->tacq = 0;
+  }
+
   lk->cpu = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
@@ -59,14 +90,16 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code doesn't use a C assignment, since the C standard
-  // implies that an assignment might be implemented with
-  // multiple store instructions.
-  // On RISC-V, sync_lock_release turns into an atomic swap:
-  //   s1 = &lk->locked
-  //   amoswap.w zero, zero, (s1)
-  __sync_lock_release(&lk->locked);
+  // Serve the next ticket, equivalent to lk->owner++.
+  // Only the holder writes owner, but this code doesn't use a
+  // C assignment, since the C standard implies that an
+  // assignment might be implemented with multiple store
+  // instructions.
+  // On RISC-V, sync_fetch_and_add turns into an atomic add:
+  //   a5 = 1
+  //   s1 = &lk->owner
+  //   amoadd.w.aqrl zero, a5, (s1)
+  __sync_fetch_and_add(&lk->owner, 1);
 
   pop_off();
 }
@@ -77,7 +110,7 @@ int
 holding(struct spinlock *lk)
 {
   int r;
-  r = (lk->locked && lk->cpu == mycpu());
+  r = (lk->owner != lk->next && lk->cpu == mycpu());
   return r;
 }
 
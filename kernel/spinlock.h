@@ -1,9 +1,14 @@
 // Mutual exclusion lock.
+// A ticket lock: acquirers take a number and are served in order.
 struct spinlock {
-  uint locked;       // Is the lock held?
+  uint next;         // Next ticket to hand out.
+  uint owner;        // Ticket now being served; held if != next.
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
-};
 
+  // For lockstat:
+  struct lockclass *class; // Statistics for locks of this name.
+  uint64 tacq;       // CLINT_MTIME when acquired, if counted.
+};
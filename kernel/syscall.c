@@ -4,7 +4,9 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
 #include "syscall.h"
+#include "sysstat.h"
 #include "defs.h"
 
 // Fetch the uint64 at addr from the current process.
@@ -12,7 +14,7 @@ int
 fetchaddr(uint64 addr, uint64 *ip)
 {
   struct proc *p = myproc();
-  if(addr >= p->sz || addr+sizeof(uint64) > p->sz)
+  if(addr >= p->vm->sz || addr+sizeof(uint64) > p->vm->sz)
     return -1;
   if(copyin(p->pagetable, (char *)ip, addr, sizeof(*ip)) != 0)
     return -1;
@@ -104,6 +106,26 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_wait(void);
 extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
+extern uint64 sys_setscheduler(void);
+extern uint64 sys_procstat(void);
+extern uint64 sys_hartstat(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
+extern uint64 sys_fcntl(void);
+extern uint64 sys_ioring_setup(void);
+extern uint64 sys_ioring_enter(void);
+extern uint64 sys_readv(void);
+extern uint64 sys_writev(void);
+extern uint64 sys_pread(void);
+extern uint64 sys_pwrite(void);
+extern uint64 sys_sendfile(void);
+extern uint64 sys_splice(void);
+extern uint64 sys_poll(void);
+extern uint64 sys_trace(void);
+extern uint64 sys_sysstat(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -127,17 +149,173 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_setscheduler] sys_setscheduler,
+[SYS_procstat] sys_procstat,
+[SYS_hartstat] sys_hartstat,
+[SYS_lockstat] sys_lockstat,
+[SYS_clone]   sys_clone,
+[SYS_join]    sys_join,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
+[SYS_fcntl]   sys_fcntl,
+[SYS_ioring_setup] sys_ioring_setup,
+[SYS_ioring_enter] sys_ioring_enter,
+[SYS_readv]   sys_readv,
+[SYS_writev]  sys_writev,
+[SYS_pread]   sys_pread,
+[SYS_pwrite]  sys_pwrite,
+[SYS_sendfile] sys_sendfile,
+[SYS_splice]  sys_splice,
+[SYS_poll]    sys_poll,
+[SYS_trace]   sys_trace,
+[SYS_sysstat] sys_sysstat,
 };
 
+static char *syscallnames[] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_setscheduler] "setscheduler",
+[SYS_procstat] "procstat",
+[SYS_hartstat] "hartstat",
+[SYS_lockstat] "lockstat",
+[SYS_clone]   "clone",
+[SYS_join]    "join",
+[SYS_futex_wait] "futex_wait",
+[SYS_futex_wake] "futex_wake",
+[SYS_fcntl]   "fcntl",
+[SYS_ioring_setup] "ioring_setup",
+[SYS_ioring_enter] "ioring_enter",
+[SYS_readv]   "readv",
+[SYS_writev]  "writev",
+[SYS_pread]   "pread",
+[SYS_pwrite]  "pwrite",
+[SYS_sendfile] "sendfile",
+[SYS_splice]  "splice",
+[SYS_poll]    "poll",
+[SYS_trace]   "trace",
+[SYS_sysstat] "sysstat",
+};
+
+// Per-call counters, always collected. Updated with atomic
+// adds, as in lockstat.c. Times are in CLINT_MTIME cycles.
+struct {
+  uint64 count;
+  uint64 time;
+  uint64 maxtime;
+  uint64 hist[NSYSHIST];
+} sysstats[NELEM(syscalls)];
+
+// Count a call to num that took t cycles.
+static void
+sysstat_add(int num, uint64 t)
+{
+  uint64 us, max;
+  int b;
+
+  __sync_fetch_and_add(&sysstats[num].time, t);
+  while(t > (max = sysstats[num].maxtime))
+    if(__sync_bool_compare_and_swap(&sysstats[num].maxtime, max, t))
+      break;
+  us = t / (MTIME_HZ / 1000000);
+  for(b = 0; us > 0 && b < NSYSHIST-1; b++)
+    us >>= 1;
+  __sync_fetch_and_add(&sysstats[num].hist[b], 1);
+}
+
+// Zero the counters, or copy the counters for calls 0..n-1
+// as struct sysstat to user address addr.
+// Returns 0, or the number copied for SYSSTAT_READ, or -1.
+int
+sysstat(int cmd, uint64 addr, int n)
+{
+  struct sysstat ss;
+  int i, b, scale = MTIME_HZ / 1000000;
+
+  switch(cmd){
+  case SYSSTAT_RESET:
+    memset(sysstats, 0, sizeof(sysstats));
+    return 0;
+  case SYSSTAT_READ:
+    if(n < 0)
+      return -1;
+    if(n > NELEM(syscalls))
+      n = NELEM(syscalls);
+    for(i = 0; i < n; i++){
+      memset(&ss, 0, sizeof(ss));
+      if(syscallnames[i])
+        safestrcpy(ss.name, syscallnames[i], sizeof(ss.name));
+      ss.count = sysstats[i].count;
+      ss.time = sysstats[i].time / scale;
+      ss.maxtime = sysstats[i].maxtime / scale;
+      for(b = 0; b < NSYSHIST; b++)
+        ss.hist[b] = sysstats[i].hist[b];
+      if(copyout(myproc()->pagetable, addr + i*sizeof(ss), (char*)&ss, sizeof(ss)) < 0)
+        return -1;
+    }
+    return n;
+  }
+  return -1;
+}
+
+// Run system call num, one of FASTCALLS, for uservec's
+// fast path, with interrupts off and no trapframe saved
+// but the caller-saved registers. Does not check p->killed
+// or give up the CPU; the next trap will. The time is still
+// charged as system time, as usertrap() and usertrapret() do.
+uint64
+fastsyscall(int num)
+{
+  uint64 r, t0;
+
+  cpumode(CPU_KERNEL);
+  __sync_fetch_and_add(&sysstats[num].count, 1);
+  t0 = readmtime();
+  r = syscalls[num]();
+  sysstat_add(num, readmtime() - t0);
+  cpumode(CPU_USER);
+  return r;
+}
+
 void
 syscall(void)
 {
   int num;
+  uint64 a0, a1, a2, t0;
   struct proc *p = myproc();
 
   num = p->trapframe->a7;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
+    // exit() does not return, so it is counted here but
+    // never timed or traced.
+    __sync_fetch_and_add(&sysstats[num].count, 1);
+    a0 = p->trapframe->a0;
+    a1 = p->trapframe->a1;
+    a2 = p->trapframe->a2;
+    t0 = readmtime();
     p->trapframe->a0 = syscalls[num]();
+    sysstat_add(num, readmtime() - t0);
+    if(p->tracemask & (1L << num))
+      printf("%d: %s(%p, %p, %p) -> %d\n", p->pid, syscallnames[num],
+             a0, a1, a2, (int)p->trapframe->a0);
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
@@ -20,3 +20,27 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_setscheduler 22
+#define SYS_procstat 23
+#define SYS_hartstat 24
+#define SYS_lockstat 25
+#define SYS_clone  26
+#define SYS_join   27
+#define SYS_futex_wait 28
+#define SYS_futex_wake 29
+#define SYS_fcntl  30
+#define SYS_ioring_setup 31
+#define SYS_ioring_enter 32
+#define SYS_readv  33
+#define SYS_writev 34
+#define SYS_pread  35
+#define SYS_pwrite 36
+#define SYS_sendfile 37
+#define SYS_splice 38
+#define SYS_poll   39
+#define SYS_trace  40
+#define SYS_sysstat 41
+
+// System calls that never sleep or fault, which uservec
+// runs through fastsyscall(); see trampoline.S.
+#define FASTCALLS ((1L << SYS_getpid) | (1L << SYS_uptime))
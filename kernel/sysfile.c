@@ -15,9 +15,29 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "uio.h"
+
+// Return the open file for descriptor fd, or 0. The caller
+// gets its own reference and must fileclose() it when done,
+// since a thread sharing the file table may close fd.
+struct file*
+fdfile(int fd)
+{
+  struct files *fs = myproc()->files;
+  struct file *f;
+
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  acquire(&fs->lock);
+  if((f = fs->ofile[fd]) != 0)
+    filedup(f);
+  release(&fs->lock);
+  return f;
+}
 
 // Fetch the nth word-sized system call argument as a file descriptor
-// and return both the descriptor and the corresponding struct file.
+// and return both the descriptor and the corresponding struct file,
+// with a reference as fdfile() gives.
 static int
 argfd(int n, int *pfd, struct file **pf)
 {
@@ -26,7 +46,7 @@ argfd(int n, int *pfd, struct file **pf)
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if((f = fdfile(fd)) == 0)
     return -1;
   if(pfd)
     *pfd = fd;
@@ -41,17 +61,37 @@ static int
 fdalloc(struct file *f)
 {
   int fd;
-  struct proc *p = myproc();
+  struct files *fs = myproc()->files;
 
+  acquire(&fs->lock);
   for(fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd] == 0){
-      p->ofile[fd] = f;
+    if(fs->ofile[fd] == 0){
+      fs->ofile[fd] = f;
+      release(&fs->lock);
       return fd;
     }
   }
+  release(&fs->lock);
   return -1;
 }
 
+// Undo fdalloc(f) of fd, and drop its reference, unless a
+// thread sharing the file table has closed fd already.
+static void
+fdunalloc(int fd, struct file *f)
+{
+  struct files *fs = myproc()->files;
+
+  acquire(&fs->lock);
+  if(fs->ofile[fd] != f){
+    release(&fs->lock);
+    return;
+  }
+  fs->ofile[fd] = 0;
+  release(&fs->lock);
+  fileclose(f);
+}
+
 uint64
 sys_dup(void)
 {
@@ -60,59 +100,274 @@ sys_dup(void)
 
   if(argfd(0, 0, &f) < 0)
     return -1;
-  if((fd=fdalloc(f)) < 0)
+  if((fd=fdalloc(f)) < 0){
+    fileclose(f);
     return -1;
-  filedup(f);
+  }
   return fd;
 }
 
+uint64
+sys_fcntl(void)
+{
+  struct file *f;
+  int cmd, arg, r;
+
+  if(argint(1, &cmd) < 0 || argint(2, &arg) < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  r = -1;
+  switch(cmd){
+  case F_GETFL:
+    r = f->nonblock ? O_NONBLOCK : 0;
+    if(f->readable && f->writable)
+      r |= O_RDWR;
+    else
+      r |= f->writable ? O_WRONLY : O_RDONLY;
+    break;
+  case F_SETFL:
+    f->nonblock = (arg & O_NONBLOCK) != 0;
+    r = 0;
+    break;
+  }
+  fileclose(f);
+  return r;
+}
+
 uint64
 sys_read(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-  return fileread(f, p, n);
+  r = fileread(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64
 sys_write(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-
-  return filewrite(f, p, n);
+  r = filewrite(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64
 sys_close(void)
 {
   int fd;
+
+  if(argint(0, &fd) < 0)
+    return -1;
+  return closefd(fd);
+}
+
+// Close descriptor fd. Returns 0, or -1 if it is not open.
+int
+closefd(int fd)
+{
   struct file *f;
+  struct files *fs = myproc()->files;
 
-  if(argfd(0, &fd, &f) < 0)
+  if(fd < 0 || fd >= NOFILE)
     return -1;
-  myproc()->ofile[fd] = 0;
+  acquire(&fs->lock);
+  if((f = fs->ofile[fd]) == 0){
+    release(&fs->lock);
+    return -1;
+  }
+  fs->ofile[fd] = 0;
+  release(&fs->lock);
   fileclose(f);
   return 0;
 }
 
+// Copy the struct stat of path, a kernel string, to user
+// address addr, as open(), fstat() and close() would.
+// Returns 0, or -1.
+int
+statpath(char *path, uint64 addr)
+{
+  struct inode *ip;
+  struct stat st;
+
+  begin_op();
+  if((ip = namei(path)) == 0){
+    end_op();
+    return -1;
+  }
+  ilockshared(ip);
+  stati(ip, &st);
+  iunlockshared(ip);
+  iput(ip);
+  end_op();
+  if(copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
+// Fetch the nth system call argument as a user iovec
+// array whose length is argument n+1, copying it into iov.
+// Returns the number of buffers, or -1.
+static int
+argiov(int n, struct iovec *iov)
+{
+  uint64 addr, tot;
+  int i, cnt;
+
+  if(argaddr(n, &addr) < 0 || argint(n+1, &cnt) < 0)
+    return -1;
+  if(cnt < 0 || cnt > MAXIOV)
+    return -1;
+  if(copyin(myproc()->pagetable, (char*)iov, addr, cnt*sizeof(*iov)) < 0)
+    return -1;
+  // the byte counts must fit in an int.
+  tot = 0;
+  for(i = 0; i < cnt; i++){
+    tot += iov[i].iov_len;
+    if(iov[i].iov_len > 0x7fffffff || tot > 0x7fffffff)
+      return -1;
+  }
+  return cnt;
+}
+
+uint64
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec iov[MAXIOV];
+  int n, r;
+
+  if((n = argiov(1, iov)) < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  r = filereadv(f, iov, n, -1);
+  fileclose(f);
+  return r;
+}
+
+uint64
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec iov[MAXIOV];
+  int n, r;
+
+  if((n = argiov(1, iov)) < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  r = filewritev(f, iov, n, -1);
+  fileclose(f);
+  return r;
+}
+
+uint64
+sys_pread(void)
+{
+  struct file *f;
+  struct iovec iov;
+  int n, off, r;
+  uint64 p;
+
+  if(argaddr(1, &p) < 0 || argint(2, &n) < 0 || argint(3, &off) < 0 ||
+     n < 0 || off < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  iov.iov_base = (void*)p;
+  iov.iov_len = n;
+  r = filereadv(f, &iov, 1, off);
+  fileclose(f);
+  return r;
+}
+
+uint64
+sys_pwrite(void)
+{
+  struct file *f;
+  struct iovec iov;
+  int n, off, r;
+  uint64 p;
+
+  if(argaddr(1, &p) < 0 || argint(2, &n) < 0 || argint(3, &off) < 0 ||
+     n < 0 || off < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  iov.iov_base = (void*)p;
+  iov.iov_len = n;
+  r = filewritev(f, &iov, 1, off);
+  fileclose(f);
+  return r;
+}
+
+uint64
+sys_sendfile(void)
+{
+  struct file *out, *in;
+  int off, n, r;
+
+  if(argint(2, &off) < 0 || argint(3, &n) < 0 || n < 0 ||
+     argfd(0, 0, &out) < 0)
+    return -1;
+  if(argfd(1, 0, &in) < 0){
+    fileclose(out);
+    return -1;
+  }
+  r = filesend(out, in, off, n);
+  fileclose(in);
+  fileclose(out);
+  return r;
+}
+
+// Like sendfile() at the files' own offsets, but one of
+// them must be a pipe.
+uint64
+sys_splice(void)
+{
+  struct file *in, *out;
+  int n, r;
+
+  if(argint(2, &n) < 0 || n < 0 || argfd(0, 0, &in) < 0)
+    return -1;
+  if(argfd(1, 0, &out) < 0){
+    fileclose(in);
+    return -1;
+  }
+  r = -1;
+  if(in->type == FD_PIPE || out->type == FD_PIPE)
+    r = filesend(out, in, -1, n);
+  fileclose(out);
+  fileclose(in);
+  return r;
+}
+
+uint64
+sys_poll(void)
+{
+  uint64 fds;
+  int n, timeout;
+
+  if(argaddr(0, &fds) < 0 || argint(1, &n) < 0 || argint(2, &timeout) < 0)
+    return -1;
+  return poll(fds, n, timeout);
+}
+
 uint64
 sys_fstat(void)
 {
   struct file *f;
   uint64 st; // user pointer to struct stat
+  int r;
 
-  if(argfd(0, 0, &f) < 0 || argaddr(1, &st) < 0)
+  if(argaddr(1, &st) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-  return filestat(f, st);
+  r = filestat(f, st);
+  fileclose(f);
+  return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -185,7 +440,6 @@ uint64
 sys_unlink(void)
 {
   struct inode *ip, *dp;
-  struct dirent de;
   char name[DIRSIZ], path[MAXPATH];
   uint off;
 
@@ -215,9 +469,8 @@ sys_unlink(void)
     goto bad;
   }
 
-  memset(&de, 0, sizeof(de));
-  if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-    panic("unlink: writei");
+  ncache_remove(dp->dev, dp->inum, name);
+  dirunlink(dp, off);
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -275,8 +528,19 @@ create(char *path, short type, short major, short minor)
       panic("create dots");
   }
 
-  if(dirlink(dp, name, ip->inum) < 0)
-    panic("create: dirlink");
+  if(dirlink(dp, name, ip->inum) < 0){
+    // The directory index is full. Undo the ".." link
+    // and let iput() free the new inode.
+    if(type == T_DIR){
+      dp->nlink--;
+      iupdate(dp);
+    }
+    ip->nlink = 0;
+    iupdate(ip);
+    iunlockput(ip);
+    iunlockput(dp);
+    return 0;
+  }
 
   iunlockput(dp);
 
@@ -287,13 +551,21 @@ uint64
 sys_open(void)
 {
   char path[MAXPATH];
-  int fd, omode;
-  struct file *f;
-  struct inode *ip;
-  int n;
+  int omode;
 
-  if((n = argstr(0, path, MAXPATH)) < 0 || argint(1, &omode) < 0)
+  if(argstr(0, path, MAXPATH) < 0 || argint(1, &omode) < 0)
     return -1;
+  return openfd(path, omode);
+}
+
+// Open path, a kernel string, with O_ flags omode.
+// Returns the new descriptor, or -1.
+int
+openfd(char *path, int omode)
+{
+  int fd;
+  struct file *f;
+  struct inode *ip;
 
   begin_op();
 
@@ -340,6 +612,7 @@ sys_open(void)
   f->ip = ip;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+  f->nonblock = (omode & O_NONBLOCK) != 0;
 
   if((omode & O_TRUNC) && ip->type == T_FILE){
     itrunc(ip);
@@ -391,7 +664,7 @@ uint64
 sys_chdir(void)
 {
   char path[MAXPATH];
-  struct inode *ip;
+  struct inode *ip, *old;
   struct proc *p = myproc();
   
   begin_op();
@@ -406,9 +679,12 @@ sys_chdir(void)
     return -1;
   }
   iunlock(ip);
-  iput(p->cwd);
+  acquire(&p->files->lock);
+  old = p->files->cwd;
+  p->files->cwd = ip;
+  release(&p->files->lock);
+  iput(old);
   end_op();
-  p->cwd = ip;
   return 0;
 }
 
@@ -469,17 +745,16 @@ sys_pipe(void)
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
     if(fd0 >= 0)
-      p->ofile[fd0] = 0;
-    fileclose(rf);
+      fdunalloc(fd0, rf);
+    else
+      fileclose(rf);
     fileclose(wf);
     return -1;
   }
   if(copyout(p->pagetable, fdarray, (char*)&fd0, sizeof(fd0)) < 0 ||
      copyout(p->pagetable, fdarray+sizeof(fd0), (char *)&fd1, sizeof(fd1)) < 0){
-    p->ofile[fd0] = 0;
-    p->ofile[fd1] = 0;
-    fileclose(rf);
-    fileclose(wf);
+    fdunalloc(fd0, rf);
+    fdunalloc(fd1, wf);
     return -1;
   }
   return 0;
@@ -38,16 +38,72 @@ sys_wait(void)
   return wait(p);
 }
 
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+
+  if(argaddr(0, &fn) < 0 || argaddr(1, &arg) < 0 || argaddr(2, &stack) < 0)
+    return -1;
+  return clone(fn, arg, stack);
+}
+
+uint64
+sys_join(void)
+{
+  uint64 p;
+  if(argaddr(0, &p) < 0)
+    return -1;
+  return join(p);
+}
+
+uint64
+sys_futex_wait(void)
+{
+  uint64 addr;
+  int val;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &val) < 0)
+    return -1;
+  return futex_wait(addr, val);
+}
+
+uint64
+sys_futex_wake(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return futex_wake(addr, n);
+}
+
+uint64
+sys_ioring_setup(void)
+{
+  return ioring_setup();
+}
+
+uint64
+sys_ioring_enter(void)
+{
+  int n;
+
+  if(argint(0, &n) < 0)
+    return -1;
+  return ioring_enter(n);
+}
+
 uint64
 sys_sbrk(void)
 {
-  int addr;
+  uint64 addr;
   int n;
 
   if(argint(0, &n) < 0)
     return -1;
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
+  if(growproc(n, &addr) < 0)
     return -1;
   return addr;
 }
@@ -95,3 +151,74 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// set the scheduling class and priority of a process.
+uint64
+sys_setscheduler(void)
+{
+  int pid, policy, prio;
+
+  if(argint(0, &pid) < 0 || argint(1, &policy) < 0 || argint(2, &prio) < 0)
+    return -1;
+  return setscheduler(pid, policy, prio);
+}
+
+// copy scheduler statistics for up to n processes.
+uint64
+sys_procstat(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return procstat(addr, n);
+}
+
+// copy scheduler statistics for up to n harts.
+uint64
+sys_hartstat(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return hartstat(addr, n);
+}
+
+// trace the system calls in a bit mask.
+uint64
+sys_trace(void)
+{
+  uint64 mask;
+
+  if(argaddr(0, &mask) < 0)
+    return -1;
+  myproc()->tracemask = mask;
+  return 0;
+}
+
+// reset or read per-call counts and latencies.
+uint64
+sys_sysstat(void)
+{
+  int cmd, n;
+  uint64 addr;
+
+  if(argint(0, &cmd) < 0 || argaddr(1, &addr) < 0 || argint(2, &n) < 0)
+    return -1;
+  return sysstat(cmd, addr, n);
+}
+
+// control and read lock contention statistics.
+uint64
+sys_lockstat(void)
+{
+  int cmd, n;
+  uint64 addr;
+
+  if(argint(0, &cmd) < 0 || argaddr(1, &addr) < 0 || argint(2, &n) < 0)
+    return -1;
+  return lockstat(cmd, addr, n);
+}
@@ -0,0 +1,19 @@
+// System call statistics; see sysstat().
+
+// sysstat() commands.
+#define SYSSTAT_RESET   0   // zero the counters
+#define SYSSTAT_READ    1   // copy out up to n struct sysstat
+
+#define NSYSHIST       16   // latency histogram buckets
+
+// Counters for one system call, indexed by its number.
+// Times are in microseconds. hist[0] counts calls that took
+// under 1us, hist[i] those that took [2^(i-1), 2^i) us, and
+// the last bucket everything longer.
+struct sysstat {
+  char name[16];            // empty if no such call
+  uint64 count;             // times called
+  uint64 time;              // total time in the call
+  uint64 maxtime;           // longest call
+  uint64 hist[NSYSHIST];
+};
@@ -4,11 +4,17 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
+#include "uclock.h"
+#include "syscall.h"
 #include "defs.h"
 
 struct spinlock tickslock;
 uint ticks;
 
+// the clock page, mapped read-only into every process at UCLOCK.
+__attribute__ ((aligned (PGSIZE))) char uclockpage[PGSIZE];
+
 extern char trampoline[], uservec[], userret[];
 
 // in kernelvec.S, calls kerneltrap().
@@ -45,6 +51,8 @@ usertrap(void)
   // since we're now in the kernel.
   w_stvec((uint64)kernelvec);
 
+  cpumode(CPU_KERNEL);
+
   struct proc *p = myproc();
   
   // save user program counter.
@@ -76,9 +84,9 @@ usertrap(void)
   if(p->killed)
     exit(-1);
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
-    yield();
+  // give up the CPU if this is a timer interrupt, or if a
+  // real-time process should preempt us.
+  preempt(which_dev == 2);
 
   usertrapret();
 }
@@ -96,6 +104,13 @@ usertrapret(void)
   // we're back in user space, where usertrap() is correct.
   intr_off();
 
+  cpumode(CPU_USER);
+  rcu_quiescent();
+
+  // a peer woken by wakeup_directed() is only worth yielding
+  // to if we sleep before going back to user space.
+  p->yieldto = 0;
+
   // send syscalls, interrupts, and exceptions to trampoline.S
   w_stvec(TRAMPOLINE + (uservec - trampoline));
 
@@ -105,6 +120,8 @@ usertrapret(void)
   p->trapframe->kernel_sp = p->kstack + PGSIZE; // process's kernel stack
   p->trapframe->kernel_trap = (uint64)usertrap;
   p->trapframe->kernel_hartid = r_tp();         // hartid for cpuid()
+  p->trapframe->kernel_fast = (uint64)fastsyscall;
+  p->trapframe->fastcalls = FASTCALLS & ~p->tracemask; // traced calls go slow
 
   // set up the registers that trampoline.S's sret will use
   // to get to user space.
@@ -125,7 +142,7 @@ usertrapret(void)
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 fn = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64,uint64))fn)(TRAPFRAME, satp);
+  ((void (*)(uint64,uint64))fn)(TRAPFRAMEN(p->thread), satp);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -149,9 +166,10 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
-    yield();
+  // give up the CPU if this is a timer interrupt, or if a
+  // real-time process should preempt us.
+  if(myproc() != 0 && myproc()->state == RUNNING)
+    preempt(which_dev == 2);
 
   // the yield() may have caused some traps to occur,
   // so restore trap registers for use by kernelvec.S's sepc instruction.
@@ -159,13 +177,60 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
+// cycles since boot, at MTIME_HZ.
+uint64
+readmtime(void)
+{
+  return *(volatile uint64*)CLINT_MTIME;
+}
+
+// Charge the time since the last call to this hart's current
+// mode (and to the running process's utime or stime), then
+// switch to mode. Returns the previous mode.
+int
+cpumode(int mode)
+{
+  struct cpu *c;
+  struct proc *p;
+  uint64 now, d;
+  int old;
+
+  push_off();
+  c = mycpu();
+  now = readmtime();
+  d = now - c->mstamp;
+  c->mstamp = now;
+  old = c->mode;
+  c->modetime[old] += d;
+  if((p = c->proc) != 0){
+    if(old == CPU_USER)
+      p->utime += d;
+    else if(old == CPU_KERNEL)
+      p->stime += d;
+  }
+  c->mode = mode;
+  pop_off();
+  return old;
+}
+
 void
 clockintr()
 {
+  struct uclock *uc = (struct uclock*)uclockpage;
+
   acquire(&tickslock);
   ticks++;
+
+  uc->seq++;
+  __sync_synchronize();
+  uc->ticks = ticks;
+  uc->mtime = readmtime();
+  __sync_synchronize();
+  uc->seq++;
+
   wakeup(&ticks);
   release(&tickslock);
+  polltick();
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -177,10 +242,12 @@ int
 devintr()
 {
   uint64 scause = r_scause();
+  int mode;
 
   if((scause & 0x8000000000000000L) &&
      (scause & 0xff) == 9){
     // this is a supervisor external interrupt, via PLIC.
+    mode = cpumode(CPU_INTR);
 
     // irq indicates which device interrupted.
     int irq = plic_claim();
@@ -199,10 +266,12 @@ devintr()
     if(irq)
       plic_complete(irq);
 
+    cpumode(mode);
     return 1;
   } else if(scause == 0x8000000000000001L){
     // software interrupt from a machine-mode timer interrupt,
     // forwarded by timervec in kernelvec.S.
+    mode = cpumode(CPU_INTR);
 
     if(cpuid() == 0){
       clockintr();
@@ -212,6 +281,7 @@ devintr()
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
+    cpumode(mode);
     return 2;
   } else {
     return 0;
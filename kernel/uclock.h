@@ -0,0 +1,10 @@
+// The clock page, mapped read-only at UCLOCK in every process
+// and updated by the kernel at each clock tick, so that user
+// programs can read the time without a system call.
+// The kernel makes seq odd while it updates the page; readers
+// retry if seq was odd or changed while they read.
+struct uclock {
+  uint seq;
+  uint ticks;        // as returned by uptime()
+  uint64 mtime;      // CLINT_MTIME at that tick
+};
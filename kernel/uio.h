@@ -0,0 +1,5 @@
+// A buffer for readv() and writev().
+struct iovec {
+  void *iov_base;
+  uint64 iov_len;
+};
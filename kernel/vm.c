@@ -299,6 +299,24 @@ uvmfree(pagetable_t pagetable, uint64 sz)
   freewalk(pagetable);
 }
 
+// Free user memory pages and page-table pages without
+// knowing the size, as when the process is long gone.
+// The trampoline, trapframe and clock page must already
+// be unmapped.
+void
+uvmfreeall(pagetable_t pagetable)
+{
+  for(int i = 0; i < 512; i++){
+    pte_t pte = pagetable[i];
+    if((pte & PTE_V) && (pte & (PTE_R|PTE_W|PTE_X)) == 0)
+      uvmfreeall((pagetable_t)PTE2PA(pte));
+    else if(pte & PTE_V)
+      kfree((void*)PTE2PA(pte));
+    pagetable[i] = 0;
+  }
+  kfree((void*)pagetable);
+}
+
 // Given a parent process's page table, copy
 // its memory into a child's page table.
 // Copies both the page table and the
@@ -0,0 +1,142 @@
+// Deferred work.
+//
+// queue_work(fn, arg) arranges for fn(arg) to be called soon
+// by a kernel thread, in process context, so that it may sleep.
+// Each hart has its own queue, serviced by a worker thread
+// pinned to that hart; work runs in the order it was queued
+// on a hart, but in no particular order across harts.
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "proc.h"
+
+struct work {
+  void (*fn)(void*);
+  void *arg;
+  struct work *next;
+};
+
+struct workqueue {
+  struct spinlock lock;
+  struct work *head;    // next to run
+  struct work *tail;    // last queued
+  struct proc *worker;  // sleeps on the queue when it is empty
+};
+
+struct workqueue workq[NCPU];
+
+struct {
+  struct spinlock lock;
+  struct work *free;
+  int pending;          // queued or running
+  struct work work[NWORK];
+} workpool;
+
+void
+workinit(void)
+{
+  int i;
+
+  initlock(&workpool.lock, "workpool");
+  for(i = 0; i < NWORK; i++){
+    workpool.work[i].next = workpool.free;
+    workpool.free = &workpool.work[i];
+  }
+  for(i = 0; i < NCPU; i++)
+    initlock(&workq[i].lock, "workq");
+}
+
+static void
+worker(void *arg)
+{
+  struct workqueue *q = arg;
+  struct work *w;
+  void (*fn)(void*);
+
+  for(;;){
+    acquire(&q->lock);
+    while((w = q->head) == 0)
+      sleep(q, &q->lock);
+    q->head = w->next;
+    if(q->head == 0)
+      q->tail = 0;
+    release(&q->lock);
+
+    fn = w->fn;
+    arg = w->arg;
+    acquire(&workpool.lock);
+    w->next = workpool.free;
+    workpool.free = w;
+    release(&workpool.lock);
+
+    fn(arg);
+
+    acquire(&workpool.lock);
+    if(--workpool.pending == 0)
+      wakeup(&workpool.pending);
+    release(&workpool.lock);
+  }
+}
+
+// Start this hart's worker thread.
+void
+workerinit(void)
+{
+  struct workqueue *q = &workq[cpuid()];
+
+  if((q->worker = kthread("kworker", worker, q, cpuid())) == 0)
+    panic("workerinit");
+}
+
+// Wait until no work is queued or running on any hart.
+// Must be called in process context, and not by work itself.
+void
+flush_work(void)
+{
+  acquire(&workpool.lock);
+  while(workpool.pending > 0)
+    sleep(&workpool.pending, &workpool.lock);
+  release(&workpool.lock);
+}
+
+// Queue fn(arg) to run on this hart's worker thread.
+// May be called from interrupt handlers and with locks held,
+// but not with the lock of a kernel worker thread.
+// Returns 0, or -1 if there is no room; the caller must then
+// do the work some other way.
+int
+queue_work(void (*fn)(void*), void *arg)
+{
+  struct workqueue *q;
+  struct work *w;
+
+  acquire(&workpool.lock);
+  if((w = workpool.free) != 0){
+    workpool.free = w->next;
+    workpool.pending++;
+  }
+  release(&workpool.lock);
+  if(w == 0)
+    return -1;
+  w->fn = fn;
+  w->arg = arg;
+  w->next = 0;
+
+  push_off();
+  q = &workq[cpuid()];
+  pop_off();
+
+  acquire(&q->lock);
+  if(q->tail)
+    q->tail->next = w;
+  else
+    q->head = w;
+  q->tail = w;
+  release(&q->lock);
+
+  wakeupproc(q->worker, q);
+  return 0;
+}
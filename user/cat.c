@@ -4,11 +4,24 @@
 
 char buf[512];
 
+// copy with sendfile(), in the kernel, unless stdout is the
+// console, which should see input as soon as it is typed.
+int usesend;
+
 void
 cat(int fd)
 {
   int n;
 
+  if(usesend){
+    while((n = sendfile(1, fd, -1, 8192)) > 0)
+      ;
+    if(n < 0){
+      fprintf(2, "cat: sendfile error\n");
+      exit(1);
+    }
+    return;
+  }
   while((n = read(fd, buf, sizeof(buf))) > 0) {
     if (write(1, buf, n) != n) {
       fprintf(2, "cat: write error\n");
@@ -25,6 +38,9 @@ int
 main(int argc, char *argv[])
 {
   int fd, i;
+  struct stat st;
+
+  usesend = fstat(1, &st) == 0 && st.type != T_DEVICE;
 
   if(argc <= 1){
     cat(0);
@@ -0,0 +1,99 @@
+// Large directory benchmark.
+//
+// Makes n names in one directory, as links to a single file
+// so as not to run out of inodes, then opens and removes
+// them all, and reports the mean time of each operation.
+//
+//   dirbench [names]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+#define NNAME 10000
+
+char path[32];
+
+// Set path to dbdir/ followed by i in decimal.
+void
+mkname(int i)
+{
+  char tmp[16];
+  int n;
+
+  strcpy(path, "dbdir/");
+  n = 0;
+  do {
+    tmp[n++] = '0' + i % 10;
+    i /= 10;
+  } while(i > 0);
+  for(i = 6; n > 0; i++)
+    path[i] = tmp[--n];
+  path[i] = 0;
+}
+
+void
+report(char *op, int n, uint64 t)
+{
+  t /= MTIME_HZ / 1000000;
+  printf("dirbench: %d %s in %d us, %d us each\n", n, op, (int)t, (int)(t / n));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, fd;
+  uint64 t0;
+
+  n = NNAME;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n <= 0){
+    fprintf(2, "usage: dirbench [names]\n");
+    exit(1);
+  }
+
+  if(mkdir("dbdir") < 0 || (fd = open("dbfile", O_CREATE|O_RDWR)) < 0){
+    fprintf(2, "dirbench: cannot create dbdir and dbfile\n");
+    exit(1);
+  }
+  close(fd);
+
+  t0 = umtime();
+  for(i = 0; i < n; i++){
+    mkname(i);
+    if(link("dbfile", path) < 0){
+      fprintf(2, "dirbench: link %s failed\n", path);
+      exit(1);
+    }
+  }
+  report("links", n, umtime() - t0);
+
+  t0 = umtime();
+  for(i = 0; i < n; i++){
+    mkname(i);
+    if((fd = open(path, O_RDONLY)) < 0){
+      fprintf(2, "dirbench: open %s failed\n", path);
+      exit(1);
+    }
+    close(fd);
+  }
+  report("opens", n, umtime() - t0);
+
+  t0 = umtime();
+  for(i = 0; i < n; i++){
+    mkname(i);
+    if(unlink(path) < 0){
+      fprintf(2, "dirbench: unlink %s failed\n", path);
+      exit(1);
+    }
+  }
+  report("unlinks", n, umtime() - t0);
+
+  unlink("dbdir");
+  unlink("dbfile");
+  exit(0);
+}
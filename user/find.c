@@ -2,6 +2,43 @@
 #include "kernel/stat.h"
 #include "user/user.h"
 #include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/ioring.h"
+
+// directory entries looked at per ioring_enter(), one
+// IORING_OP_STAT each, which fills the ring.
+#define NBATCH NIOSQ
+
+struct ioring *ring;
+
+// Stat the n paths in path[] into st[], with one system call
+// if there is a ring. ok[i] is set if path[i] could be stat()ed.
+void statbatch(char (*path)[512], struct stat *st, int *ok, int n){
+    struct iosqe *sqe;
+    struct iocqe *cqe;
+    int i;
+
+    if(ring == 0){
+        for(i = 0; i < n; i++)
+            ok[i] = stat(path[i], &st[i]) >= 0;
+        return;
+    }
+    for(i = 0; i < n; i++){
+        ok[i] = 1;
+        sqe = ioring_get(ring);
+        sqe->op = IORING_OP_STAT;
+        sqe->addr = (uint64)path[i];
+        sqe->addr2 = (uint64)&st[i];
+        sqe->data = i;
+        ioring_queue(ring);
+    }
+    ioring_enter(0);
+    while((cqe = ioring_peek(ring)) != 0){
+        if(cqe->res < 0)
+            ok[cqe->data] = 0;
+        ioring_seen(ring);
+    }
+}
 
 void match(const char* path, const char* name){//判断path中是否有与name匹配的子串
     int pp = 0;//指向path
@@ -26,10 +63,11 @@ void match(const char* path, const char* name){//判断path中是否有与name
 }
 
 void find(char *path, char *name){
-    char buf[512], *p;
-    int fd;
-    struct dirent de;//目录项结构体
-    struct stat st;
+    char (*buf)[512], *p;
+    int fd, i, n, len;
+    struct dirent *de;//目录项结构体
+    struct stat st, *sts;
+    int *ok;
 
     if((fd = open(path, 0)) < 0){//检测能否打开path，如果能，把文件描述符存在md
         fprintf(2, "ls: cannot open %s\n", path);
@@ -47,27 +85,51 @@ void find(char *path, char *name){
             break;
 
         case T_DIR://文件夹
-            if(strlen(path) + 1 + DIRSIZ + 1 > sizeof buf){
+            if(strlen(path) + 1 + DIRSIZ + 1 > sizeof buf[0]){
                 printf("ls: path too long\n");
                 break;
             }
-            strcpy(buf, path);//把目录路径加入buf
-            p = buf+strlen(buf);
-            *p++ = '/';//在路径末尾加上'/'
-            while(read(fd, &de, sizeof(de)) == sizeof(de)){//de包含了文件信息。
-            //这一步是从打开的目录文件中读取文件信息，并将其保存在de变量中，sizeof(de)是文件大小，如果读取成功则==
-                if(de.inum == 0)
-                    continue;
-                if(de.name[0] == '.' && de.name[1] == 0) continue;//如果是'.'或'..'目录，不用检查
-                if(de.name[0] == '.' && de.name[1] == '.' && de.name[2] == 0) continue;
-                memmove(p, de.name, DIRSIZ);//把文件名复制到p指针之后，得到了目录下的一个路径
-                p[DIRSIZ] = 0;
-                if(stat(buf, &st) < 0){//获取新路径的状态信息
-                    printf("ls: cannot stat %s\n", buf);
-                    continue;
+            buf = malloc(NBATCH * sizeof buf[0]);
+            sts = malloc(NBATCH * sizeof sts[0]);
+            // a batch is too big for find()'s stack frame, which
+            // recursion repeats.
+            de = malloc(NBATCH * sizeof de[0]);
+            ok = malloc(NBATCH * sizeof ok[0]);
+            if(buf == 0 || sts == 0 || de == 0 || ok == 0){
+                fprintf(2, "find: out of memory\n");
+                exit(1);
+            }
+            // read a batch of entries at a time, and stat them all at once.
+            while((len = read(fd, de, NBATCH * sizeof de[0])) >= (int)sizeof(de[0])){
+                n = 0;
+                for(i = 0; i < len / sizeof(de[0]); i++){
+                    if(de[i].inum == 0)
+                        continue;
+                    if(de[i].name[0] == '.' && de[i].name[1] == 0) continue;//如果是'.'或'..'目录，不用检查
+                    if(de[i].name[0] == '.' && de[i].name[1] == '.' && de[i].name[2] == 0) continue;
+                    strcpy(buf[n], path);//把目录路径加入buf
+                    p = buf[n]+strlen(buf[n]);
+                    *p++ = '/';//在路径末尾加上'/'
+                    memmove(p, de[i].name, DIRSIZ);//把文件名复制到p指针之后，得到了目录下的一个路径
+                    p[DIRSIZ] = 0;
+                    n++;
+                }
+                statbatch(buf, sts, ok, n);
+                for(i = 0; i < n; i++){
+                    if(!ok[i]){
+                        printf("ls: cannot stat %s\n", buf[i]);
+                        continue;
+                    }
+                    if(sts[i].type == T_FILE)
+                        match(buf[i], name);
+                    else if(sts[i].type == T_DIR)
+                        find(buf[i], name);//在新路径下继续寻找name
                 }
-                find(buf, name);//在新路径下继续寻找name
             }
+            free(buf);
+            free(sts);
+            free(de);
+            free(ok);
             break;
     }
     close(fd);
@@ -79,6 +141,9 @@ main(int argc, char *argv[]){
         printf("Usage: find [path] [filename]\n");
         exit(-1);
     }
+    ring = ioring_setup();
+    if(ring == (struct ioring*)-1)
+        ring = 0;
     find(argv[1], argv[2]);//argv[0]存的是函数名称
     exit(0);
 }
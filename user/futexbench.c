@@ -0,0 +1,97 @@
+// User-space lock contention benchmark.
+//
+// Several threads increment a shared counter, each increment
+// under one lock, first a futex-based mutex and then a plain
+// test-and-set spinlock. With more threads than harts, the
+// spinlock wastes whole time slices spinning on a holder
+// that has been switched out, where the mutex sleeps.
+//
+//   futexbench [nthread [iters]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+#define NTHR 4
+#define NITER 20000
+
+int iters;
+volatile int counter;
+struct mutex mu;
+volatile int spin;
+
+void
+mutexloop(void *arg)
+{
+  int i;
+
+  for(i = 0; i < iters; i++){
+    mutex_lock(&mu);
+    counter++;
+    mutex_unlock(&mu);
+  }
+}
+
+void
+spinloop(void *arg)
+{
+  int i;
+
+  for(i = 0; i < iters; i++){
+    while(__sync_lock_test_and_set(&spin, 1) != 0)
+      ;
+    counter++;
+    __sync_lock_release(&spin);
+  }
+}
+
+void
+run(char *what, void (*fn)(void*), int nthread)
+{
+  int i;
+  uint64 t0, t1;
+
+  counter = 0;
+  t0 = umtime();
+  for(i = 0; i < nthread; i++){
+    if(thread_create(fn, 0) < 0){
+      fprintf(2, "futexbench: thread_create failed\n");
+      exit(1);
+    }
+  }
+  for(i = 0; i < nthread; i++)
+    thread_join(0);
+  t1 = umtime();
+
+  if(counter != nthread * iters){
+    fprintf(2, "futexbench: %s: counter %d, expected %d\n",
+            what, counter, nthread * iters);
+    exit(1);
+  }
+  t1 = (t1 - t0) / (MTIME_HZ / 1000);
+  printf("%s: %d threads x %d: %d ms\n", what, nthread, iters, (int)t1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nthread;
+
+  nthread = NTHR;
+  iters = NITER;
+  if(argc > 1)
+    nthread = atoi(argv[1]);
+  if(argc > 2)
+    iters = atoi(argv[2]);
+  if(nthread <= 0 || iters <= 0){
+    fprintf(2, "usage: futexbench [nthread [iters]]\n");
+    exit(1);
+  }
+
+  mutex_init(&mu);
+  run("mutex", mutexloop, nthread);
+  run("spin", spinloop, nthread);
+  exit(0);
+}
@@ -0,0 +1,48 @@
+// Helpers for the submission and completion rings;
+// see kernel/ioring.h.
+
+#include "kernel/types.h"
+#include "kernel/ioring.h"
+#include "user/user.h"
+
+// Return a cleared submission entry to fill in, or 0
+// if the ring is full. ioring_queue() submits it.
+struct iosqe*
+ioring_get(struct ioring *r)
+{
+  struct iosqe *sqe;
+
+  if(r->sqtail - r->sqhead >= NIOSQ)
+    return 0;
+  sqe = &r->sq[r->sqtail % NIOSQ];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+void
+ioring_queue(struct ioring *r)
+{
+  // the kernel must see the entry before the new tail.
+  __sync_synchronize();
+  r->sqtail++;
+}
+
+// Return the oldest completion not yet consumed, or 0.
+// ioring_seen() consumes it.
+struct iocqe*
+ioring_peek(struct ioring *r)
+{
+  if(r->cqhead == r->cqtail)
+    return 0;
+  // read the completion only after seeing the tail.
+  __sync_synchronize();
+  return &r->cq[r->cqhead % NIOCQ];
+}
+
+void
+ioring_seen(struct ioring *r)
+{
+  // finish reading the completion before the kernel may reuse it.
+  __sync_synchronize();
+  r->cqhead++;
+}
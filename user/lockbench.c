@@ -0,0 +1,85 @@
+// Kernel lock contention benchmark.
+//
+// Runs several processes at once, each making system calls
+// that take one hot kernel lock: uptime() takes tickslock,
+// and sbrk() up and down by a page takes the allocator's
+// kmem lock. Reports the total time and how far apart the
+// first and last process finished, which grows if the lock
+// starves some harts.
+//
+//   lockbench [nproc [iters]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NPROC 4
+#define NITER 20000
+
+void
+run(char *what, int nproc, int iters)
+{
+  int fds[2], i, k, t, t0, first, last;
+
+  if(pipe(fds) < 0){
+    fprintf(2, "lockbench: pipe failed\n");
+    exit(1);
+  }
+  t0 = uptime();
+  for(i = 0; i < nproc; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "lockbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      close(fds[0]);
+      for(k = 0; k < iters; k++){
+        if(what[0] == 'u'){
+          uptime();
+        } else if(sbrk(4096) == (char*)-1 || sbrk(-4096) == (char*)-1){
+          fprintf(2, "lockbench: sbrk failed\n");
+          exit(1);
+        }
+      }
+      // report when we finished.
+      t = uptime();
+      write(fds[1], &t, sizeof(t));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+
+  first = last = -1;
+  while(read(fds[0], &t, sizeof(t)) == sizeof(t)){
+    if(first < 0 || t < first)
+      first = t;
+    if(t > last)
+      last = t;
+  }
+  close(fds[0]);
+  for(i = 0; i < nproc; i++)
+    wait(0);
+
+  printf("lockbench: %s: %d procs x %d in %d ticks, finish spread %d ticks\n",
+         what, nproc, iters, last - t0, last - first);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = NPROC, iters = NITER;
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    iters = atoi(argv[2]);
+  if(nproc <= 0 || iters <= 0){
+    fprintf(2, "usage: lockbench [nproc [iters]]\n");
+    exit(1);
+  }
+
+  run("uptime", nproc, iters);
+  run("sbrk", nproc, iters);
+  exit(0);
+}
@@ -0,0 +1,79 @@
+// Show kernel lock contention statistics.
+//
+//   lockstat on | off | reset   control collection
+//   lockstat                    print locks, most contended first
+//   lockstat cmd [args...]      reset, run cmd with collection on,
+//                               then print
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+struct lockstat ls[NLOCKSTAT];
+
+void
+print(void)
+{
+  int i, j, n;
+  struct lockstat t;
+
+  if((n = lockstat(LOCKSTAT_READ, ls, NLOCKSTAT)) < 0){
+    fprintf(2, "lockstat: read failed\n");
+    exit(1);
+  }
+
+  // insertion sort, most contended first.
+  for(i = 1; i < n; i++){
+    t = ls[i];
+    for(j = i; j > 0 && ls[j-1].contended < t.contended; j--)
+      ls[j] = ls[j-1];
+    ls[j] = t;
+  }
+
+  printf("name kind acquires contended spins hold(us) avg(us) max(us) spin-won spin-lost\n");
+  for(i = 0; i < n; i++){
+    if(ls[i].acquires == 0)
+      continue;
+    printf("%s %s %d %d %d %d %d %d %d %d\n", ls[i].name,
+           ls[i].kind == LOCK_SLEEP ? "sleep" : "spin",
+           (int)ls[i].acquires, (int)ls[i].contended, (int)ls[i].spins,
+           (int)ls[i].holdtime, (int)(ls[i].holdtime / ls[i].acquires),
+           (int)ls[i].maxhold, (int)ls[i].spinwins, (int)ls[i].spinlosses);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  if(argc < 2){
+    print();
+    exit(0);
+  }
+  if(strcmp(argv[1], "on") == 0){
+    lockstat(LOCKSTAT_ON, 0, 0);
+  } else if(strcmp(argv[1], "off") == 0){
+    lockstat(LOCKSTAT_OFF, 0, 0);
+  } else if(strcmp(argv[1], "reset") == 0){
+    lockstat(LOCKSTAT_RESET, 0, 0);
+  } else {
+    lockstat(LOCKSTAT_RESET, 0, 0);
+    lockstat(LOCKSTAT_ON, 0, 0);
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "lockstat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], argv + 1);
+      fprintf(2, "lockstat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+    lockstat(LOCKSTAT_OFF, 0, 0);
+    print();
+  }
+  exit(0);
+}
@@ -0,0 +1,68 @@
+// Path name lookup benchmark.
+//
+// Several processes repeatedly open and close the same file
+// four directories deep, which mostly exercises namex().
+//
+//   namebench [nproc [iters]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define NPROC 4
+#define NITER 2000
+
+int
+main(int argc, char *argv[])
+{
+  int i, k, fd, nproc = NPROC, iters = NITER, t0, t1;
+  char *dirs[] = { "nb", "nb/a", "nb/a/b", "nb/a/b/c" };
+  char *file = "nb/a/b/c/f";
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    iters = atoi(argv[2]);
+  if(nproc <= 0 || iters <= 0){
+    fprintf(2, "usage: namebench [nproc [iters]]\n");
+    exit(1);
+  }
+
+  for(i = 0; i < 4; i++)
+    mkdir(dirs[i]);
+  if((fd = open(file, O_CREATE|O_RDWR)) < 0){
+    fprintf(2, "namebench: cannot create %s\n", file);
+    exit(1);
+  }
+  close(fd);
+
+  t0 = uptime();
+  for(i = 0; i < nproc; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "namebench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      for(k = 0; k < iters; k++){
+        if((fd = open(file, O_RDONLY)) < 0){
+          fprintf(2, "namebench: open failed\n");
+          exit(1);
+        }
+        close(fd);
+      }
+      exit(0);
+    }
+  }
+  for(i = 0; i < nproc; i++)
+    wait(0);
+  t1 = uptime();
+
+  printf("namebench: %d procs x %d opens in %d ticks\n", nproc, iters, t1 - t0);
+
+  unlink(file);
+  for(i = 3; i >= 0; i--)
+    unlink(dirs[i]);
+  exit(0);
+}
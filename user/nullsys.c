@@ -0,0 +1,55 @@
+// System call latency benchmark.
+//
+// Times getpid() and uptime(), which take the fast path
+// through uservec, against close(-1), which fails at once
+// but takes the full trap path, and reports the mean
+// time per call of each.
+//
+//   nullsys [calls]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+#define NCALL 100000
+
+void
+report(char *name, int n, uint64 t)
+{
+  t = t * 1000 / (MTIME_HZ / 1000000);  // ns
+  printf("nullsys: %s %d ns/call\n", name, (int)(t / n));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n;
+  uint64 t0;
+
+  n = NCALL;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n <= 0){
+    fprintf(2, "usage: nullsys [calls]\n");
+    exit(1);
+  }
+
+  t0 = umtime();
+  for(i = 0; i < n; i++)
+    getpid();
+  report("getpid", n, umtime() - t0);
+
+  t0 = umtime();
+  for(i = 0; i < n; i++)
+    uptime();
+  report("uptime", n, umtime() - t0);
+
+  t0 = umtime();
+  for(i = 0; i < n; i++)
+    close(-1);
+  report("close(-1)", n, umtime() - t0);
+
+  exit(0);
+}
@@ -0,0 +1,68 @@
+// Pipe round-trip latency benchmark.
+//
+// Two processes bounce a one-byte token over a pair of pipes,
+// as in pingpong, and report the mean round-trip time.
+//
+//   pipelat [round-trips]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+#define NROUND 10000
+
+int
+main(int argc, char *argv[])
+{
+  int p2c[2], c2p[2];
+  int i, n, pid;
+  uint64 t0, t1;
+  char c = 'x';
+
+  n = NROUND;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n <= 0){
+    fprintf(2, "usage: pipelat [round-trips]\n");
+    exit(1);
+  }
+
+  if(pipe(p2c) < 0 || pipe(c2p) < 0){
+    fprintf(2, "pipelat: pipe failed\n");
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "pipelat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(p2c[1]);
+    close(c2p[0]);
+    while(read(p2c[0], &c, 1) == 1)
+      write(c2p[1], &c, 1);
+    exit(0);
+  }
+
+  close(p2c[0]);
+  close(c2p[1]);
+  t0 = umtime();
+  for(i = 0; i < n; i++){
+    if(write(p2c[1], &c, 1) != 1 || read(c2p[0], &c, 1) != 1){
+      fprintf(2, "pipelat: round trip %d failed\n", i);
+      exit(1);
+    }
+  }
+  t1 = umtime();
+  close(p2c[1]);
+  close(c2p[0]);
+  wait(0);
+
+  t1 = (t1 - t0) / (MTIME_HZ / 1000000);
+  printf("pipelat: %d round trips in %d us, %d us each\n",
+         n, (int)t1, (int)(t1 / n));
+  exit(0);
+}
@@ -0,0 +1,105 @@
+// Wake-up latency under load, with and without SCHED_FIFO.
+//
+// Starts some CPU-bound processes, then times sleep(1) calls,
+// first as an ordinary process and then as a SCHED_FIFO one.
+// Each sleep(1) ends at the next clock tick; the time from
+// that tick until umtime() runs, read from the clock page and
+// rdtime, is time spent runnable but waiting for a CPU.
+//
+//   rtlat [hogs [sleeps]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/uclock.h"
+#include "user/user.h"
+
+#define NHOG   4
+#define NSLEEP 50
+#define TICKCYCLES 1000000  // CLINT_MTIME cycles per tick; see start.c
+
+// CLINT_MTIME at the latest clock tick, from the clock page.
+uint64
+tickmtime(void)
+{
+  volatile struct uclock *uc = (struct uclock*)UCLOCK;
+  uint seq;
+  uint64 t;
+
+  do {
+    seq = uc->seq;
+    __sync_synchronize();
+    t = uc->mtime;
+    __sync_synchronize();
+  } while((seq & 1) || seq != uc->seq);
+  return t;
+}
+
+void
+run(char *what, int n)
+{
+  int i, scale = MTIME_HZ / 1000000;
+  uint64 wake, now, late, tot, max;
+
+  // start just after a tick.
+  sleep(1);
+  tot = max = 0;
+  for(i = 0; i < n; i++){
+    wake = tickmtime() + TICKCYCLES;
+    sleep(1);
+    // the kernel stamps a tick a little after it is due.
+    now = umtime();
+    late = now > wake ? now - wake : 0;
+    tot += late;
+    if(late > max)
+      max = late;
+  }
+  printf("rtlat: %s: %d sleeps, %d us late on average, %d us at most\n",
+         what, n, (int)(tot / n / scale), (int)(max / scale));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, nhog, n, pids[64];
+
+  nhog = NHOG;
+  n = NSLEEP;
+  if(argc > 1)
+    nhog = atoi(argv[1]);
+  if(argc > 2)
+    n = atoi(argv[2]);
+  if(nhog < 0 || nhog > 64 || n <= 0){
+    fprintf(2, "usage: rtlat [hogs [sleeps]]\n");
+    exit(1);
+  }
+
+  for(i = 0; i < nhog; i++){
+    pids[i] = fork();
+    if(pids[i] < 0){
+      fprintf(2, "rtlat: fork failed\n");
+      nhog = i;
+      break;
+    }
+    if(pids[i] == 0)
+      for(;;)
+        ;
+  }
+
+  run("SCHED_OTHER", n);
+  if(setscheduler(0, SCHED_FIFO, SCHED_MAXPRIO) < 0){
+    fprintf(2, "rtlat: setscheduler failed\n");
+  } else {
+    run("SCHED_FIFO", n);
+    setscheduler(0, SCHED_OTHER, 0);
+  }
+
+  for(i = 0; i < nhog; i++){
+    kill(pids[i]);
+    wait(0);
+  }
+  exit(0);
+}
@@ -0,0 +1,73 @@
+// Print scheduler statistics for each process and hart.
+//
+//   schedstat [-h]
+//
+// -h also prints the run-queue wait and time slice histograms.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+static char *states[] = { "unused", "sleep", "runble", "run", "zombie" };
+
+struct procstat ps[NPROC];
+struct hartstat hs[NCPU];
+
+void
+hist(char *what, uint64 *h)
+{
+  int i;
+
+  printf("  %s:", what);
+  for(i = 0; i < NSCHEDHIST; i++)
+    if(h[i])
+      printf(" <%dus:%d", 1 << i, (int)h[i]);
+  printf("\n");
+}
+
+void
+print(struct schedstat *s, int showhist)
+{
+  printf(" vcsw %d ivcsw %d run %dus wait %dus max %dus\n",
+         (int)s->nvcsw, (int)s->nivcsw, (int)s->runtime,
+         (int)s->waittime, (int)s->maxwait);
+  if(showhist){
+    hist("wait", s->waithist);
+    hist("slice", s->slicehist);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, showhist = 0;
+
+  if(argc > 1 && strcmp(argv[1], "-h") == 0)
+    showhist = 1;
+  else if(argc > 1){
+    fprintf(2, "usage: schedstat [-h]\n");
+    exit(1);
+  }
+
+  if((n = procstat(ps, NPROC)) < 0){
+    fprintf(2, "schedstat: procstat failed\n");
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    printf("%d %s %s", ps[i].pid, states[ps[i].state], ps[i].name);
+    if(ps[i].policy == SCHED_FIFO)
+      printf(" fifo %d", ps[i].rtprio);
+    print(&ps[i].s, showhist);
+  }
+
+  if((n = hartstat(hs, NCPU)) < 0){
+    fprintf(2, "schedstat: hartstat failed\n");
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    printf("hart %d pid %d", hs[i].hart, hs[i].pid);
+    print(&hs[i].s, showhist);
+  }
+  exit(0);
+}
@@ -0,0 +1,81 @@
+// Trace the system calls a command makes.
+//
+//   strace cmd [args...]            trace every call
+//   strace -e name,name cmd [args...]
+//                                   trace only the named calls
+//
+// The kernel prints one line per call as it returns:
+// pid: name(a0, a1, a2) -> result. exit() is never printed.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sysstat.h"
+#include "user/user.h"
+
+#define NSYSCALL 64
+
+struct sysstat ss[NSYSCALL];
+
+// Return the mask for a comma-separated list of call names.
+uint64
+parsemask(char *list)
+{
+  uint64 mask = 0;
+  char *p, *e;
+  int i, n, found;
+
+  if((n = sysstat(SYSSTAT_READ, ss, NSYSCALL)) < 0){
+    fprintf(2, "strace: sysstat failed\n");
+    exit(1);
+  }
+  for(p = list; *p; p = e){
+    for(e = p; *e && *e != ','; e++)
+      ;
+    found = 0;
+    for(i = 1; i < n; i++){
+      if(strlen(ss[i].name) == e - p && memcmp(ss[i].name, p, e - p) == 0){
+        mask |= 1L << i;
+        found = 1;
+      }
+    }
+    if(!found){
+      *e = 0;
+      fprintf(2, "strace: unknown system call %s\n", p);
+      exit(1);
+    }
+    if(*e)
+      e++;
+  }
+  return mask;
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 mask = ~0L;
+  int pid;
+
+  if(argc > 2 && strcmp(argv[1], "-e") == 0){
+    mask = parsemask(argv[2]);
+    argv += 2;
+    argc -= 2;
+  }
+  if(argc < 2){
+    fprintf(2, "usage: strace [-e name,...] cmd [args...]\n");
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "strace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    trace(mask);
+    exec(argv[1], argv + 1);
+    fprintf(2, "strace: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  exit(0);
+}
@@ -0,0 +1,100 @@
+// Show how often each system call is made and how long it takes.
+//
+//   syscount                    print calls, most time first
+//   syscount reset              zero the counters
+//   syscount cmd [args...]      reset, run cmd, then print
+//   syscount -h ...             also print latency histograms
+//
+// The counters are system-wide and always on, so a command's
+// figures include calls made by anything else running.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sysstat.h"
+#include "user/user.h"
+
+#define NSYSCALL 64
+
+struct sysstat ss[NSYSCALL];
+int hflag;
+
+void
+print(void)
+{
+  int i, j, n, b;
+  struct sysstat t;
+
+  if((n = sysstat(SYSSTAT_READ, ss, NSYSCALL)) < 0){
+    fprintf(2, "syscount: read failed\n");
+    exit(1);
+  }
+
+  // insertion sort, most time first.
+  for(i = 1; i < n; i++){
+    t = ss[i];
+    for(j = i; j > 0 && ss[j-1].time < t.time; j--)
+      ss[j] = ss[j-1];
+    ss[j] = t;
+  }
+
+  printf("name count time(us) avg(us) max(us)\n");
+  for(i = 0; i < n; i++){
+    if(ss[i].count == 0)
+      continue;
+    printf("%s %d %d %d %d\n", ss[i].name, (int)ss[i].count,
+           (int)ss[i].time, (int)(ss[i].time / ss[i].count),
+           (int)ss[i].maxtime);
+  }
+  if(!hflag)
+    return;
+  for(i = 0; i < n; i++){
+    if(ss[i].count == 0)
+      continue;
+    printf("\n%s latency (us):\n", ss[i].name);
+    for(b = 0; b < NSYSHIST; b++){
+      if(ss[i].hist[b] == 0)
+        continue;
+      if(b == 0)
+        printf("  <1: %d\n", (int)ss[i].hist[b]);
+      else if(b == NSYSHIST-1)
+        printf("  >=%d: %d\n", 1 << (b-1), (int)ss[i].hist[b]);
+      else
+        printf("  %d-%d: %d\n", 1 << (b-1), (1 << b) - 1, (int)ss[i].hist[b]);
+    }
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  if(argc > 1 && strcmp(argv[1], "-h") == 0){
+    hflag = 1;
+    argv++;
+    argc--;
+  }
+  if(argc < 2){
+    print();
+    exit(0);
+  }
+  if(strcmp(argv[1], "reset") == 0){
+    sysstat(SYSSTAT_RESET, 0, 0);
+    exit(0);
+  }
+
+  sysstat(SYSSTAT_RESET, 0, 0);
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "syscount: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "syscount: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  print();
+  exit(0);
+}
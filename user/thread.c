@@ -0,0 +1,150 @@
+// Threads, built on clone() and join(), and mutexes and
+// condition variables, built on futex_wait() and futex_wake().
+//
+// Each thread gets a malloc()ed stack, freed by thread_join().
+// malloc() is not thread-safe, so only one thread at a time
+// should create or join threads.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define TSTACKSIZE (2*4096)
+
+// what a new thread calls, kept at the top of its stack.
+struct tstart {
+  void (*fn)(void*);
+  void *arg;
+};
+
+static struct {
+  int pid;
+  void *stack;
+} threads[NTHREAD];
+
+static void
+threadstart(void *a)
+{
+  struct tstart *ts = a;
+
+  ts->fn(ts->arg);
+  exit(0);
+}
+
+// Start a thread running fn(arg), which exits when fn returns.
+// Returns its pid, or -1.
+int
+thread_create(void (*fn)(void*), void *arg)
+{
+  char *stack;
+  struct tstart *ts;
+  int i, pid;
+
+  for(i = 0; i < NTHREAD; i++)
+    if(threads[i].stack == 0)
+      break;
+  if(i == NTHREAD)
+    return -1;
+  if((stack = malloc(TSTACKSIZE)) == 0)
+    return -1;
+
+  // the stack pointer must be 16-byte aligned.
+  ts = (struct tstart*)(((uint64)(stack + TSTACKSIZE) & ~15) - 16);
+  ts->fn = fn;
+  ts->arg = arg;
+  if((pid = clone(threadstart, ts, ts)) < 0){
+    free(stack);
+    return -1;
+  }
+  threads[i].pid = pid;
+  threads[i].stack = stack;
+  return pid;
+}
+
+// Wait for a thread to exit, and free its stack.
+// Returns its pid, or -1 if there are no threads.
+int
+thread_join(int *status)
+{
+  int i, pid;
+
+  if((pid = join(status)) < 0)
+    return -1;
+  for(i = 0; i < NTHREAD; i++){
+    if(threads[i].stack && threads[i].pid == pid){
+      free(threads[i].stack);
+      threads[i].stack = 0;
+      break;
+    }
+  }
+  return pid;
+}
+
+void
+mutex_init(struct mutex *m)
+{
+  m->state = 0;
+}
+
+// Uncontended, lock and unlock are one atomic instruction
+// each; only a lock that finds waiters makes system calls.
+void
+mutex_lock(struct mutex *m)
+{
+  int c;
+
+  if((c = __sync_val_compare_and_swap(&m->state, 0, 1)) == 0)
+    return;
+  // mark it contended, so that the holder wakes us.
+  if(c != 2)
+    c = __sync_lock_test_and_set(&m->state, 2);
+  while(c != 0){
+    futex_wait(&m->state, 2);
+    c = __sync_lock_test_and_set(&m->state, 2);
+  }
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  if(__sync_fetch_and_sub(&m->state, 1) != 1){
+    __sync_lock_release(&m->state);
+    futex_wake(&m->state, 1);
+  }
+}
+
+void
+cond_init(struct cond *c)
+{
+  c->seq = 0;
+}
+
+// Release m and wait for a signal, then take m again.
+// As usual, the caller must recheck its condition.
+void
+cond_wait(struct cond *c, struct mutex *m)
+{
+  int seq = c->seq;
+
+  mutex_unlock(m);
+  // returns at once if a signal came after we read seq.
+  futex_wait(&c->seq, seq);
+  // other waiters may have been woken too, so take the
+  // lock as contended.
+  while(__sync_lock_test_and_set(&m->state, 2) != 0)
+    futex_wait(&m->state, 2);
+}
+
+void
+cond_signal(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, 1);
+}
+
+void
+cond_broadcast(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, NPROC);
+}
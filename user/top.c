@@ -0,0 +1,127 @@
+// Show CPU use per hart and per process, refreshed until killed.
+//
+//   top [interval-ticks [count]]
+//
+// Each refresh prints, for every hart, the share of the last
+// interval it spent in user mode, in the kernel, handling
+// interrupts and idle; then every process that ran, busiest
+// first, with its share of one hart.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+#define INTERVAL 10  // ticks, about a second
+
+static char *states[] = { "unused", "sleep", "runble", "run", "zombie" };
+
+struct procstat ps[2][NPROC];
+struct hartstat hs[2][NCPU];
+int nps[2], nhs[2];
+
+struct {
+  int i;          // index in ps[cur]
+  uint64 busy;    // utime + stime over the interval
+} top[NPROC];
+
+// CPU time of process pid as of the previous sample.
+uint64
+prevbusy(int prev, int pid)
+{
+  int i;
+
+  for(i = 0; i < nps[prev]; i++)
+    if(ps[prev][i].pid == pid)
+      return ps[prev][i].utime + ps[prev][i].stime;
+  return 0;
+}
+
+int
+pct(uint64 n, uint64 d)
+{
+  return d ? (int)(n * 100 / d) : 0;
+}
+
+int
+sample(int cur)
+{
+  if((nps[cur] = procstat(ps[cur], NPROC)) < 0 ||
+     (nhs[cur] = hartstat(hs[cur], NCPU)) < 0){
+    fprintf(2, "top: procstat failed\n");
+    return -1;
+  }
+  return 0;
+}
+
+void
+show(int cur)
+{
+  int prev = !cur, i, j, m, n;
+  uint64 d[NCPUMODE], tot, elapsed = 0;
+  struct procstat *p;
+
+  for(i = 0; i < nhs[cur] && i < nhs[prev]; i++){
+    tot = 0;
+    for(m = 0; m < NCPUMODE; m++){
+      d[m] = hs[cur][i].modetime[m] - hs[prev][i].modetime[m];
+      tot += d[m];
+    }
+    if(tot > elapsed)
+      elapsed = tot;
+    printf("hart %d: %d%% user %d%% sys %d%% intr %d%% idle\n",
+           hs[cur][i].hart, pct(d[CPU_USER], tot), pct(d[CPU_KERNEL], tot),
+           pct(d[CPU_INTR], tot), pct(d[CPU_IDLE], tot));
+  }
+
+  // insertion sort, busiest first.
+  n = 0;
+  for(i = 0; i < nps[cur]; i++){
+    p = &ps[cur][i];
+    tot = p->utime + p->stime - prevbusy(prev, p->pid);
+    if(tot == 0)
+      continue;
+    for(j = n; j > 0 && top[j-1].busy < tot; j--)
+      top[j] = top[j-1];
+    top[j].i = i;
+    top[j].busy = tot;
+    n++;
+  }
+
+  printf("pid state %%cpu user(ms) sys(ms) name\n");
+  for(j = 0; j < n; j++){
+    p = &ps[cur][top[j].i];
+    printf("%d %s %d %d %d %s\n", p->pid, states[p->state],
+           pct(top[j].busy, elapsed), (int)(p->utime / 1000),
+           (int)(p->stime / 1000), p->name);
+  }
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int interval = INTERVAL, count = -1, cur = 0;
+
+  if(argc > 1)
+    interval = atoi(argv[1]);
+  if(argc > 2)
+    count = atoi(argv[2]);
+  if(interval <= 0 || argc > 3){
+    fprintf(2, "usage: top [interval-ticks [count]]\n");
+    exit(1);
+  }
+
+  if(sample(cur) < 0)
+    exit(1);
+  while(count != 0){
+    sleep(interval);
+    cur = !cur;
+    if(sample(cur) < 0)
+      exit(1);
+    show(cur);
+    if(count > 0)
+      count--;
+  }
+  exit(0);
+}
@@ -1,6 +1,9 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/uclock.h"
 #include "user/user.h"
 
 char*
@@ -134,3 +137,30 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// Like uptime(), but reads the kernel's clock page
+// instead of making a system call.
+uint
+uuptime(void)
+{
+  volatile struct uclock *uc = (struct uclock*)UCLOCK;
+  uint seq, t;
+
+  do {
+    seq = uc->seq;
+    __sync_synchronize();
+    t = uc->ticks;
+    __sync_synchronize();
+  } while((seq & 1) || seq != uc->seq);
+  return t;
+}
+
+// CLINT_MTIME, which counts at MTIME_HZ, read with rdtime.
+uint64
+umtime(void)
+{
+  uint64 t;
+
+  asm volatile("rdtime %0" : "=r" (t));
+  return t;
+}
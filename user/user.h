@@ -1,5 +1,14 @@
 struct stat;
 struct rtcdate;
+struct procstat;
+struct hartstat;
+struct lockstat;
+struct ioring;
+struct iosqe;
+struct iocqe;
+struct iovec;
+struct pollfd;
+struct sysstat;
 
 // system calls
 int fork(void);
@@ -23,6 +32,26 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int setscheduler(int, int, int);
+int procstat(struct procstat*, int);
+int hartstat(struct hartstat*, int);
+int lockstat(int, struct lockstat*, int);
+int clone(void (*)(void*), void*, void*);
+int join(int*);
+int futex_wait(volatile int*, int);
+int futex_wake(volatile int*, int);
+int fcntl(int, int, int);
+struct ioring* ioring_setup(void);
+int ioring_enter(int);
+int readv(int, const struct iovec*, int);
+int writev(int, const struct iovec*, int);
+int pread(int, void*, int, int);
+int pwrite(int, const void*, int, int);
+int sendfile(int, int, int, int);
+int splice(int, int, int);
+int poll(struct pollfd*, int, int);
+int trace(uint64);
+int sysstat(int, struct sysstat*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -38,5 +67,38 @@ void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
 int atoi(const char*);
+uint uuptime(void);
+uint64 umtime(void);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+
+// ioring.c
+struct iosqe* ioring_get(struct ioring*);
+void ioring_queue(struct ioring*);
+struct iocqe* ioring_peek(struct ioring*);
+void ioring_seen(struct ioring*);
+
+// uthread.c
+int uthread_create(void (*)(void*), void*);
+void uthread_yield(void);
+void uthread_exit(void);
+void uthread_run(void);
+int uthread_read(int, void*, int);
+int uthread_write(int, const void*, int);
+
+// thread.c
+struct mutex {
+  volatile int state;  // 0 unlocked, 1 locked, 2 locked with waiters
+};
+struct cond {
+  volatile int seq;    // bumped by every signal
+};
+int thread_create(void (*)(void*), void*);
+int thread_join(int*);
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
+void cond_init(struct cond*);
+void cond_wait(struct cond*, struct mutex*);
+void cond_signal(struct cond*);
+void cond_broadcast(struct cond*);
@@ -7,6 +7,11 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/sched.h"
+#include "kernel/ioring.h"
+#include "kernel/uio.h"
+#include "kernel/poll.h"
+#include "kernel/sysstat.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -791,6 +796,945 @@ preempt(char *s)
   wait(0);
 }
 
+// setscheduler() argument checks, and a SCHED_FIFO
+// process forking and waiting for a child.
+void
+rtsched(char *s)
+{
+  int pid, xstatus;
+
+  if(setscheduler(0, SCHED_FIFO, 0) == 0 ||
+     setscheduler(0, SCHED_FIFO, SCHED_MAXPRIO+1) == 0 ||
+     setscheduler(0, SCHED_OTHER, 1) == 0 ||
+     setscheduler(0, 7, 1) == 0 ||
+     setscheduler(-1, SCHED_OTHER, 0) == 0){
+    printf("%s: setscheduler accepted bad arguments\n", s);
+    exit(1);
+  }
+  if(setscheduler(0, SCHED_FIFO, 10) < 0){
+    printf("%s: setscheduler failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0)
+    exit(setscheduler(0, SCHED_OTHER, 0) == 0 ? 0 : 1);
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: child failed\n", s);
+    exit(1);
+  }
+  if(setscheduler(0, SCHED_OTHER, 0) < 0){
+    printf("%s: setscheduler failed\n", s);
+    exit(1);
+  }
+}
+
+// procstat() should count our sleeps as voluntary switches.
+void
+procstattest(char *s)
+{
+  static struct procstat ps[NPROC];
+  int i, n, pid = getpid();
+  uint64 before = 0;
+
+  n = procstat(ps, NPROC);
+  for(i = 0; i < n; i++)
+    if(ps[i].pid == pid)
+      before = ps[i].s.nvcsw;
+  sleep(1);
+  sleep(1);
+  n = procstat(ps, NPROC);
+  for(i = 0; i < n; i++)
+    if(ps[i].pid == pid)
+      break;
+  if(i == n){
+    printf("%s: pid %d not in procstat\n", s, pid);
+    exit(1);
+  }
+  if(ps[i].s.nvcsw < before + 2){
+    printf("%s: sleeps not counted\n", s);
+    exit(1);
+  }
+  if(procstat((struct procstat*)0xffffffffffffffffULL, 1) != -1){
+    printf("%s: procstat accepted a bad address\n", s);
+    exit(1);
+  }
+}
+
+// several processes reading one file at once, each through
+// its own open file, which lets them share the inode lock.
+void
+sharedread(char *s)
+{
+  int fd, i, k, n, pid, xstatus;
+  char *name = "sharedread";
+
+  fd = open(name, O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 20; i++){
+    memset(buf, 'a' + i, 512);
+    if(write(fd, buf, 512) != 512){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  for(k = 0; k < 4; k++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      for(int rep = 0; rep < 10; rep++){
+        if((fd = open(name, O_RDONLY)) < 0){
+          printf("%s: open failed\n", s);
+          exit(1);
+        }
+        for(i = 0; (n = read(fd, buf, 512)) > 0; i++){
+          if(n != 512 || buf[0] != 'a' + i || buf[511] != 'a' + i){
+            printf("%s: wrong data\n", s);
+            exit(1);
+          }
+        }
+        close(fd);
+        if(i != 20){
+          printf("%s: short file\n", s);
+          exit(1);
+        }
+      }
+      exit(0);
+    }
+  }
+  for(k = 0; k < 4; k++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+  unlink(name);
+}
+
+// the clock page agrees with uptime() and cannot be written.
+void
+uclocktest(char *s)
+{
+  int pid, xstatus;
+  uint t0, t1;
+  uint64 m0, m1;
+
+  t0 = uptime();
+  t1 = uuptime();
+  if(t1 < t0 || t1 > t0 + 1){
+    printf("%s: uuptime %d, uptime %d\n", s, t1, t0);
+    exit(1);
+  }
+  m0 = umtime();
+  sleep(1);
+  m1 = umtime();
+  if(m1 <= m0){
+    printf("%s: umtime did not advance\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    *(volatile uint*)UCLOCK = 0;
+    printf("%s: wrote the clock page\n", s);
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != -1)
+    exit(1);
+}
+
+// state shared with the threads of clonetest.
+static volatile int tcount, tfd, tgo;
+static char * volatile tmem;
+
+static void
+tadd(void *arg)
+{
+  int i;
+
+  for(i = 0; i < 1000; i++)
+    __sync_fetch_and_add(&tcount, 1);
+}
+
+static void
+tgrow(void *arg)
+{
+  tmem = sbrk(4096);
+  if(tmem != (char*)-1)
+    tmem[4095] = 'x';
+  tfd = open((char*)arg, O_CREATE|O_RDWR);
+}
+
+static void
+tspin(void *arg)
+{
+  while(tgo == 0)
+    ;
+}
+
+// threads made by clone() share memory, open files,
+// and are collected by join() but not wait().
+void
+clonetest(char *s)
+{
+  int i, pid, xstatus;
+  char *args[] = { "echo", 0 };
+  char name[] = "clonefile";
+
+  tcount = 0;
+  for(i = 0; i < 4; i++){
+    if(thread_create(tadd, 0) < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  if(wait(0) != -1){
+    printf("%s: wait returned a thread\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 4; i++){
+    if(thread_join(&xstatus) < 0 || xstatus != 0){
+      printf("%s: thread_join failed\n", s);
+      exit(1);
+    }
+  }
+  if(tcount != 4000){
+    printf("%s: count %d, expected 4000\n", s, tcount);
+    exit(1);
+  }
+
+  tfd = -1;
+  if(thread_create(tgrow, name) < 0 || thread_join(0) < 0){
+    printf("%s: thread failed\n", s);
+    exit(1);
+  }
+  if(tmem == (char*)-1 || tmem[4095] != 'x'){
+    printf("%s: thread's sbrk not visible\n", s);
+    exit(1);
+  }
+  if(tfd < 0 || write(tfd, "x", 1) != 1){
+    printf("%s: thread's open file not shared\n", s);
+    exit(1);
+  }
+  close(tfd);
+  unlink(name);
+
+  tgo = 0;
+  if((pid = thread_create(tspin, 0)) < 0){
+    printf("%s: thread_create failed\n", s);
+    exit(1);
+  }
+  if(exec("echo", args) != -1){
+    printf("%s: exec with threads succeeded\n", s);
+    exit(1);
+  }
+  tgo = 1;
+  if(thread_join(0) != pid){
+    printf("%s: thread_join returned the wrong pid\n", s);
+    exit(1);
+  }
+  if(join(0) != -1){
+    printf("%s: join with no threads succeeded\n", s);
+    exit(1);
+  }
+}
+
+static struct mutex fmu;
+static struct cond fcond;
+static volatile int fcount, fready;
+
+static void
+fworker(void *arg)
+{
+  int i;
+
+  mutex_lock(&fmu);
+  while(fready == 0)
+    cond_wait(&fcond, &fmu);
+  mutex_unlock(&fmu);
+
+  for(i = 0; i < 1000; i++){
+    mutex_lock(&fmu);
+    fcount++;
+    mutex_unlock(&fmu);
+  }
+}
+
+// futex_wait() checks the word, and mutexes and condition
+// variables built on futexes work between threads.
+void
+futextest(char *s)
+{
+  int i;
+  volatile int w = 1;
+
+  if(futex_wait(&w, 0) != -1){
+    printf("%s: futex_wait slept on a stale value\n", s);
+    exit(1);
+  }
+  if(futex_wake(&w, 1) != 0){
+    printf("%s: futex_wake woke a phantom\n", s);
+    exit(1);
+  }
+  if(futex_wait((int*)0xffffffffffL, 0) != -1){
+    printf("%s: futex_wait on a bad address\n", s);
+    exit(1);
+  }
+
+  mutex_init(&fmu);
+  cond_init(&fcond);
+  fcount = fready = 0;
+  for(i = 0; i < 4; i++){
+    if(thread_create(fworker, 0) < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  sleep(1);
+  mutex_lock(&fmu);
+  fready = 1;
+  cond_broadcast(&fcond);
+  mutex_unlock(&fmu);
+  for(i = 0; i < 4; i++)
+    thread_join(0);
+  if(fcount != 4000){
+    printf("%s: count %d, expected 4000\n", s, fcount);
+    exit(1);
+  }
+}
+
+// read() and write() on O_NONBLOCK pipes return EAGAIN
+// instead of sleeping.
+void
+nonblockpipe(char *s)
+{
+  int fds[2], i, n;
+  char c = 'x';
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0 ||
+     fcntl(fds[1], F_SETFL, O_NONBLOCK) < 0 ||
+     fcntl(fds[0], F_GETFL, 0) != (O_RDONLY|O_NONBLOCK)){
+    printf("%s: fcntl failed\n", s);
+    exit(1);
+  }
+  if(read(fds[0], &c, 1) != EAGAIN){
+    printf("%s: read of empty pipe did not return EAGAIN\n", s);
+    exit(1);
+  }
+  for(i = 0; (n = write(fds[1], &c, 1)) == 1; i++)
+    ;
+  if(n != EAGAIN || i == 0){
+    printf("%s: write to full pipe returned %d after %d\n", s, n, i);
+    exit(1);
+  }
+  if(read(fds[0], &c, 1) != 1 || write(fds[1], &c, 1) != 1){
+    printf("%s: pipe stuck\n", s);
+    exit(1);
+  }
+  close(fds[1]);
+  while((n = read(fds[0], &c, 1)) == 1)
+    ;
+  if(n != 0){
+    printf("%s: read at end of pipe returned %d\n", s, n);
+    exit(1);
+  }
+  close(fds[0]);
+}
+
+// open, write, fstat, read and close a file with one
+// ioring_enter() each way, then stat it by name.
+void
+ioringtest(char *s)
+{
+  struct ioring *r;
+  struct iosqe *sqe;
+  struct iocqe *cqe;
+  struct stat st;
+  char buf[8];
+  int i, res[4];
+  char *name = "ioringfile";
+
+  if(ioring_enter(0) != -1){
+    printf("%s: ioring_enter without a ring\n", s);
+    exit(1);
+  }
+  if((r = ioring_setup()) == (struct ioring*)-1){
+    printf("%s: ioring_setup failed\n", s);
+    exit(1);
+  }
+  if(ioring_setup() != r){
+    printf("%s: second ioring_setup moved the ring\n", s);
+    exit(1);
+  }
+
+  sqe = ioring_get(r);
+  sqe->op = IORING_OP_OPEN;
+  sqe->addr = (uint64)name;
+  sqe->len = O_CREATE|O_RDWR;
+  ioring_queue(r);
+  sqe = ioring_get(r);
+  sqe->op = IORING_OP_WRITE;
+  sqe->flags = IOSQE_PREVFD;
+  sqe->addr = (uint64)"ring";
+  sqe->len = 4;
+  sqe->data = 1;
+  ioring_queue(r);
+  sqe = ioring_get(r);
+  sqe->op = IORING_OP_FSTAT;
+  sqe->flags = IOSQE_PREVFD;
+  sqe->addr = (uint64)&st;
+  sqe->data = 2;
+  ioring_queue(r);
+  sqe = ioring_get(r);
+  sqe->op = IORING_OP_CLOSE;
+  sqe->flags = IOSQE_PREVFD;
+  sqe->data = 3;
+  ioring_queue(r);
+  if(ioring_enter(0) != 4){
+    printf("%s: ioring_enter did not run the batch\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 4; i++){
+    if((cqe = ioring_peek(r)) == 0 || cqe->data != i){
+      printf("%s: completion %d missing\n", s, i);
+      exit(1);
+    }
+    res[i] = cqe->res;
+    ioring_seen(r);
+  }
+  if(res[0] < 0 || res[1] != 4 || res[2] != 0 || res[3] != 0 || st.size != 4){
+    printf("%s: batch results %d %d %d %d\n", s, res[0], res[1], res[2], res[3]);
+    exit(1);
+  }
+
+  sqe = ioring_get(r);
+  sqe->op = IORING_OP_OPEN;
+  sqe->addr = (uint64)name;
+  sqe->len = O_RDONLY;
+  ioring_queue(r);
+  sqe = ioring_get(r);
+  sqe->op = IORING_OP_READ;
+  sqe->flags = IOSQE_PREVFD;
+  sqe->addr = (uint64)buf;
+  sqe->len = sizeof(buf);
+  ioring_queue(r);
+  sqe = ioring_get(r);
+  sqe->op = IORING_OP_CLOSE;
+  sqe->flags = IOSQE_PREVFD;
+  ioring_queue(r);
+  ioring_enter(0);
+  ioring_seen(r);
+  cqe = ioring_peek(r);
+  if(cqe == 0 || cqe->res != 4 || memcmp(buf, "ring", 4) != 0){
+    printf("%s: read through the ring failed\n", s);
+    exit(1);
+  }
+  ioring_seen(r);
+  ioring_seen(r);
+
+  memset(&st, 0, sizeof(st));
+  sqe = ioring_get(r);
+  sqe->op = IORING_OP_STAT;
+  sqe->addr = (uint64)name;
+  sqe->addr2 = (uint64)&st;
+  ioring_queue(r);
+  ioring_enter(0);
+  cqe = ioring_peek(r);
+  if(cqe == 0 || cqe->res != 0 || st.type != T_FILE || st.size != 4){
+    printf("%s: stat through the ring failed\n", s);
+    exit(1);
+  }
+  ioring_seen(r);
+  unlink(name);
+}
+
+// readv() and writev() move the file offset over all the
+// buffers; pread() and pwrite() leave it alone. writev()
+// refuses a vector too big for one transaction.
+void
+iovtest(char *s)
+{
+  struct iovec iov[3];
+  char a[4], b[6], c[8];
+  int fd;
+  char *name = "iovfile";
+
+  if((fd = open(name, O_CREATE|O_RDWR)) < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  iov[0].iov_base = "head";
+  iov[0].iov_len = 4;
+  iov[1].iov_base = "";
+  iov[1].iov_len = 0;
+  iov[2].iov_base = "payload";
+  iov[2].iov_len = 7;
+  if(writev(fd, iov, 3) != 11){
+    printf("%s: writev failed\n", s);
+    exit(1);
+  }
+  if(pwrite(fd, "PAY", 3, 4) != 3 || write(fd, "!", 1) != 1){
+    printf("%s: pwrite failed\n", s);
+    exit(1);
+  }
+  if(pread(fd, c, 8, 0) != 8 || memcmp(c, "headPAYl", 8) != 0){
+    printf("%s: pread got the wrong data\n", s);
+    exit(1);
+  }
+  // several buffers must fit in one log transaction.
+  iov[0].iov_base = buf;
+  iov[0].iov_len = BUFSZ/2;
+  iov[1].iov_base = buf + BUFSZ/2;
+  iov[1].iov_len = BUFSZ/2;
+  if(writev(fd, iov, 2) != -1){
+    printf("%s: writev too big for one transaction\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  if((fd = open(name, O_RDONLY)) < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  iov[0].iov_base = a;
+  iov[0].iov_len = sizeof(a);
+  iov[1].iov_base = b;
+  iov[1].iov_len = sizeof(b);
+  if(readv(fd, iov, 2) != 10 || memcmp(a, "head", 4) != 0 ||
+     memcmp(b, "PAYloa", 6) != 0){
+    printf("%s: readv got the wrong data\n", s);
+    exit(1);
+  }
+  if(read(fd, c, sizeof(c)) != 2 || memcmp(c, "d!", 2) != 0){
+    printf("%s: readv left the offset wrong\n", s);
+    exit(1);
+  }
+  if(pread(fd, c, 1, 100) != 0 || pread(fd, c, 1, -1) != -1){
+    printf("%s: pread past the end\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink(name);
+}
+
+// sendfile() and splice() copy between files and pipes
+// without going through user memory.
+void
+sendfiletest(char *s)
+{
+  int src, dst, fds[2], i;
+  char buf[16];
+
+  src = open("sendsrc", O_CREATE|O_RDWR);
+  dst = open("senddst", O_CREATE|O_RDWR);
+  if(src < 0 || dst < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 1000; i++)
+    if(write(src, "0123456789", 10) != 10){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  if(sendfile(dst, src, 0, 20000) != 10000){
+    printf("%s: sendfile at an offset copied the wrong amount\n", s);
+    exit(1);
+  }
+  if(sendfile(dst, src, -1, 10) != 0){
+    printf("%s: sendfile past the end\n", s);
+    exit(1);
+  }
+  if(pread(dst, buf, 10, 9990) != 10 || memcmp(buf, "0123456789", 10) != 0){
+    printf("%s: sendfile wrote the wrong data\n", s);
+    exit(1);
+  }
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(splice(src, dst, 10) != -1){
+    printf("%s: splice without a pipe\n", s);
+    exit(1);
+  }
+  if(sendfile(fds[1], src, 5, 5) != 5 || splice(fds[0], dst, 100) != 5){
+    printf("%s: sendfile and splice through a pipe failed\n", s);
+    exit(1);
+  }
+  if(pread(dst, buf, 5, 10000) != 5 || memcmp(buf, "56789", 5) != 0){
+    printf("%s: splice wrote the wrong data\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+  close(src);
+  close(dst);
+  unlink("sendsrc");
+  unlink("senddst");
+}
+
+// poll() reports readable and hung-up pipes and bad fds,
+// and sleeps until a pipe becomes readable.
+void
+polltest(char *s)
+{
+  int a[2], b[2], pid, xstatus;
+  struct pollfd pfd[3];
+  char c = 'x';
+
+  if(pipe(a) < 0 || pipe(b) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  pfd[0].fd = a[0];
+  pfd[0].events = POLLIN;
+  pfd[1].fd = b[0];
+  pfd[1].events = POLLIN;
+  if(poll(pfd, 2, 0) != 0 || pfd[0].revents || pfd[1].revents){
+    printf("%s: empty pipes were ready\n", s);
+    exit(1);
+  }
+  if(poll(pfd, 2, 2) != 0){
+    printf("%s: timed poll did not time out\n", s);
+    exit(1);
+  }
+  write(b[1], &c, 1);
+  if(poll(pfd, 2, -1) != 1 || pfd[0].revents || pfd[1].revents != POLLIN){
+    printf("%s: readable pipe not reported\n", s);
+    exit(1);
+  }
+  read(b[0], &c, 1);
+
+  pfd[2].fd = a[1];
+  pfd[2].events = POLLOUT;
+  close(b[1]);
+  if(poll(pfd, 3, 0) != 2 || pfd[1].revents != (POLLIN|POLLHUP) ||
+     pfd[2].revents != POLLOUT){
+    printf("%s: hangup or writable pipe not reported\n", s);
+    exit(1);
+  }
+  close(b[0]);
+  if(poll(pfd, 2, 0) != 1 || pfd[1].revents != POLLNVAL){
+    printf("%s: closed fd not reported\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    sleep(5);
+    write(a[1], &c, 1);
+    exit(0);
+  }
+  if(poll(pfd, 1, -1) != 1 || pfd[0].revents != POLLIN){
+    printf("%s: poll did not wake for a write\n", s);
+    exit(1);
+  }
+  wait(&xstatus);
+  close(a[0]);
+  close(a[1]);
+  exit(xstatus);
+}
+
+// sysstat() counts each call and puts it in a histogram
+// bucket, and rejects a negative count.
+void
+sysstattest(char *s)
+{
+  static struct sysstat ss[SYS_sysstat+1];
+  uint64 count, nhist;
+  int i, b, pid;
+
+  if(sysstat(SYSSTAT_READ, ss, SYS_sysstat+1) != SYS_sysstat+1 ||
+     strcmp(ss[SYS_getpid].name, "getpid") != 0){
+    printf("%s: sysstat read failed\n", s);
+    exit(1);
+  }
+  count = ss[SYS_getpid].count;
+  for(i = 0; i < 100; i++)
+    getpid();
+  sysstat(SYSSTAT_READ, ss, SYS_sysstat+1);
+  if(ss[SYS_getpid].count < count + 100){
+    printf("%s: getpid counted %d times, not 100\n", s,
+           (int)(ss[SYS_getpid].count - count));
+    exit(1);
+  }
+  nhist = 0;
+  for(b = 0; b < NSYSHIST; b++)
+    nhist += ss[SYS_getpid].hist[b];
+  if(nhist < 100 || nhist > ss[SYS_getpid].count){
+    printf("%s: histogram holds %d of %d calls\n", s,
+           (int)nhist, (int)ss[SYS_getpid].count);
+    exit(1);
+  }
+
+  if(sysstat(SYSSTAT_READ, ss, -1) != -1){
+    printf("%s: sysstat accepted a negative count\n", s);
+    exit(1);
+  }
+
+  // a traced getpid() leaves the fast path but still works.
+  pid = getpid();
+  if(trace(1L << SYS_getpid) != 0){
+    printf("%s: trace failed\n", s);
+    exit(1);
+  }
+  if(getpid() != pid){
+    printf("%s: traced getpid returned the wrong pid\n", s);
+    exit(1);
+  }
+  trace(0);
+}
+
+// a file made by the kernel maps its blocks with extents,
+// so it can grow past MAXFILE blocks.
+void
+extenttest(char *s)
+{
+  int fd, i, n;
+
+  fd = open("extent", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  n = MAXFILE + 20;
+  for(i = 0; i < n; i++){
+    ((int*)buf)[0] = i;
+    if(write(fd, buf, BSIZE) != BSIZE){
+      printf("%s: write of block %d failed\n", s, i);
+      exit(1);
+    }
+  }
+  ((int*)buf)[0] = -1;
+  if(pwrite(fd, buf, sizeof(int), 100*BSIZE) != sizeof(int)){
+    printf("%s: overwrite failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("extent", O_RDONLY);
+  for(i = 0; i < n; i++){
+    if(read(fd, buf, BSIZE) != BSIZE ||
+       ((int*)buf)[0] != (i == 100 ? -1 : i)){
+      printf("%s: block %d reads back wrong\n", s, i);
+      exit(1);
+    }
+  }
+  if(read(fd, buf, BSIZE) != 0){
+    printf("%s: read past the end\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  // truncating frees the extents for reuse.
+  fd = open("extent", O_RDWR|O_TRUNC);
+  if(fd < 0 || write(fd, "x", 1) != 1){
+    printf("%s: rewrite after truncate failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(unlink("extent") < 0){
+    printf("%s: unlink failed\n", s);
+    exit(1);
+  }
+}
+
+// hold more than NINODE inodes open at once, across
+// several processes.
+void
+manyinodes(char *s)
+{
+  enum { NCHILD = 6, NOPEN = 11 };
+  int ready[2], done[2], i, j, pid, xstatus;
+  char name[8], c;
+
+  if(pipe(ready) < 0 || pipe(done) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < NCHILD; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      close(ready[0]);
+      close(done[1]);
+      name[0] = 'i';
+      name[1] = 'a' + i;
+      name[3] = 0;
+      for(j = 0; j < NOPEN; j++){
+        name[2] = 'a' + j;
+        if(open(name, O_CREATE|O_RDWR) < 0){
+          printf("%s: open %s failed\n", s, name);
+          write(ready[1], "x", 1);
+          exit(1);
+        }
+        unlink(name);
+      }
+      write(ready[1], "x", 1);
+      read(done[0], &c, 1);
+      exit(0);
+    }
+  }
+  close(ready[1]);
+  for(i = 0; i < NCHILD; i++){
+    if(read(ready[0], &c, 1) != 1){
+      printf("%s: child failed\n", s);
+      exit(1);
+    }
+  }
+  close(done[1]);
+  for(i = 0; i < NCHILD; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(xstatus);
+  }
+  close(ready[0]);
+  close(done[0]);
+}
+
+// a cached failed lookup must not hide a name created,
+// or linked, afterwards.
+void
+negcache(char *s)
+{
+  int fd, i;
+
+  for(i = 0; i < 2; i++){
+    if(open("negfile", O_RDONLY) >= 0 || open("negdir/f", O_RDONLY) >= 0){
+      printf("%s: open of missing file succeeded\n", s);
+      exit(1);
+    }
+  }
+  fd = open("negfile", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if((fd = open("negfile", O_RDONLY)) < 0){
+    printf("%s: created file not found\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(mkdir("negdir") < 0 || link("negfile", "negdir/f") < 0){
+    printf("%s: mkdir or link failed\n", s);
+    exit(1);
+  }
+  if((fd = open("negdir/f", O_RDONLY)) < 0){
+    printf("%s: linked file not found\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("negdir/f");
+  unlink("negfile");
+  if(open("negfile", O_RDONLY) >= 0 || open("negdir/f", O_RDONLY) >= 0){
+    printf("%s: unlinked file found\n", s);
+    exit(1);
+  }
+  unlink("negdir");
+}
+
+// a directory big enough to be indexed, and to split index
+// leaves, finds its names, and reuses the slots of removed ones.
+void
+dirindex(char *s)
+{
+  enum { N = 400 };
+  int i, fd;
+  char name[10];
+  struct stat st1, st2;
+
+  if(mkdir("di") < 0 || (fd = open("di/f", O_CREATE|O_RDWR)) < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  strcpy(name, "di/x00");
+  for(i = 0; i < N; i++){
+    name[4] = '0' + i / 64;
+    name[5] = '0' + i % 64;
+    if(link("di/f", name) < 0){
+      printf("%s: link %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  for(i = 0; i < N; i += 2){
+    name[4] = '0' + i / 64;
+    name[5] = '0' + i % 64;
+    if(unlink(name) < 0){
+      printf("%s: unlink %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  for(i = 0; i < N; i++){
+    name[4] = '0' + i / 64;
+    name[5] = '0' + i % 64;
+    fd = open(name, O_RDONLY);
+    if((fd >= 0) != (i % 2 == 1)){
+      printf("%s: open %s %s\n", s, name, fd >= 0 ? "succeeded" : "failed");
+      exit(1);
+    }
+    if(fd >= 0)
+      close(fd);
+  }
+
+  fd = open("di", O_RDONLY);
+  fstat(fd, &st1);
+  for(i = 0; i < N; i += 2){
+    name[4] = '0' + i / 64;
+    name[5] = '0' + i % 64;
+    if(link("di/f", name) < 0){
+      printf("%s: relink %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  fstat(fd, &st2);
+  close(fd);
+  if(st2.size != st1.size){
+    printf("%s: directory grew from %d to %d\n", s, (int)st1.size, (int)st2.size);
+    exit(1);
+  }
+
+  for(i = 0; i < N; i++){
+    name[4] = '0' + i / 64;
+    name[5] = '0' + i % 64;
+    if(unlink(name) < 0){
+      printf("%s: final unlink %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  if(unlink("di/f") < 0 || unlink("di") < 0){
+    printf("%s: cleanup failed\n", s);
+    exit(1);
+  }
+}
+
 // try to find any races between exit and wait
 void
 exitwait(char *s)
@@ -2665,6 +3609,7 @@ main(int argc, char *argv[])
     {subdir, "subdir"},
     {fourfiles, "fourfiles"},
     {sharedfd, "sharedfd"},
+    {sharedread, "sharedread"},
     {exectest, "exectest"},
     {bigargtest, "bigargtest"},
     {bigwrite, "bigwrite"},
@@ -2686,6 +3631,21 @@ main(int argc, char *argv[])
     {mem, "mem"},
     {pipe1, "pipe1"},
     {preempt, "preempt"},
+    {rtsched, "rtsched"},
+    {procstattest, "procstat"},
+    {uclocktest, "uclock"},
+    {clonetest, "clone"},
+    {futextest, "futex"},
+    {nonblockpipe, "nonblockpipe"},
+    {ioringtest, "ioring"},
+    {iovtest, "iov"},
+    {sendfiletest, "sendfile"},
+    {polltest, "poll"},
+    {sysstattest, "sysstat"},
+    {extenttest, "extent"},
+    {manyinodes, "manyinodes"},
+    {negcache, "negcache"},
+    {dirindex, "dirindex"},
     {exitwait, "exitwait"},
     {rmdot, "rmdot"},
     {fourteen, "fourteen"},
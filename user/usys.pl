@@ -36,3 +36,23 @@ entry("getpid");
 entry("sbrk");
 entry("sleep");
 entry("uptime");
+entry("setscheduler");
+entry("procstat");
+entry("hartstat");
+entry("lockstat");
+entry("clone");
+entry("join");
+entry("futex_wait");
+entry("futex_wake");
+entry("fcntl");
+entry("ioring_setup");
+entry("ioring_enter");
+entry("readv");
+entry("writev");
+entry("pread");
+entry("pwrite");
+entry("sendfile");
+entry("splice");
+entry("poll");
+entry("trace");
+entry("sysstat");
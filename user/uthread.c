@@ -0,0 +1,195 @@
+// User-level threads, switched cooperatively.
+//
+// All uthreads run inside one process, on one hart; a thread
+// runs until it calls uthread_yield(), uthread_exit(), or an
+// I/O wrapper that would block. They cost a malloc()ed stack
+// each and no kernel state, so a program can have thousands.
+//
+// uthread_read() and uthread_write() expect an O_NONBLOCK file
+// (see fcntl()), and yield to other threads rather than sleep
+// in the kernel. When every thread is waiting for I/O, the
+// process sleeps a tick at a time.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define USTACKSIZE 4096
+
+// callee-saved registers, as in the kernel's struct context.
+struct ucontext {
+  uint64 ra;
+  uint64 sp;
+  uint64 s[12];
+};
+
+struct uthread {
+  struct ucontext ctx;
+  char *stack;
+  void (*fn)(void*);
+  void *arg;
+  struct uthread *next;  // in the run queue or dead list
+};
+
+void uthread_switch(struct ucontext*, struct ucontext*);
+
+static struct ucontext mainctx;   // uthread_run()'s caller
+static struct uthread *current;
+static struct uthread *runq, *runqtail;
+static struct uthread *dead;      // exited; stacks not yet freed
+static int nthread;               // created and not yet exited
+static int nidle;                 // yields in a row that found no I/O ready
+
+static void
+enqueue(struct uthread *t)
+{
+  t->next = 0;
+  if(runqtail)
+    runqtail->next = t;
+  else
+    runq = t;
+  runqtail = t;
+}
+
+static struct uthread*
+dequeue(void)
+{
+  struct uthread *t;
+
+  if((t = runq) != 0){
+    runq = t->next;
+    if(runq == 0)
+      runqtail = 0;
+  }
+  return t;
+}
+
+// free threads that have exited. the caller is not
+// one of them, so it is not on any of their stacks.
+static void
+reap(void)
+{
+  struct uthread *t;
+
+  while((t = dead) != 0){
+    dead = t->next;
+    free(t->stack);
+    free(t);
+  }
+}
+
+// switch from the current thread, which has already been
+// queued or marked dead, to the next runnable one, or back
+// to uthread_run() if there is none.
+static void
+schedule(void)
+{
+  struct uthread *t, *prev;
+
+  prev = current;
+  if((t = dequeue()) == prev)
+    return;
+  current = t;
+  uthread_switch(&prev->ctx, t ? &t->ctx : &mainctx);
+  reap();
+}
+
+static void
+uthread_start(void)
+{
+  current->fn(current->arg);
+  uthread_exit();
+}
+
+// Create a thread that will run fn(arg) once uthread_run()
+// is called, and exit when fn returns. Returns 0, or -1 if
+// out of memory.
+int
+uthread_create(void (*fn)(void*), void *arg)
+{
+  struct uthread *t;
+
+  reap();
+  if((t = malloc(sizeof(*t))) == 0)
+    return -1;
+  if((t->stack = malloc(USTACKSIZE)) == 0){
+    free(t);
+    return -1;
+  }
+  memset(&t->ctx, 0, sizeof(t->ctx));
+  t->ctx.ra = (uint64)uthread_start;
+  t->ctx.sp = (uint64)(t->stack + USTACKSIZE) & ~15;
+  t->fn = fn;
+  t->arg = arg;
+  enqueue(t);
+  nthread++;
+  return 0;
+}
+
+// Let the other runnable threads run.
+void
+uthread_yield(void)
+{
+  nidle = 0;
+  enqueue(current);
+  schedule();
+}
+
+void
+uthread_exit(void)
+{
+  current->next = dead;
+  dead = current;
+  nthread--;
+  schedule();
+}
+
+// Run threads until they have all exited.
+void
+uthread_run(void)
+{
+  struct uthread *t;
+
+  if((t = dequeue()) != 0){
+    current = t;
+    uthread_switch(&mainctx, &t->ctx);
+  }
+  current = 0;
+  reap();
+}
+
+// called when an I/O wrapper would block.
+static void
+iowait(void)
+{
+  // if every thread has come round without progress,
+  // nothing is ready, so give up the CPU for a while.
+  if(++nidle > nthread){
+    sleep(1);
+    nidle = 0;
+  }
+  enqueue(current);
+  schedule();
+}
+
+int
+uthread_read(int fd, void *buf, int n)
+{
+  int r;
+
+  while((r = read(fd, buf, n)) == EAGAIN)
+    iowait();
+  nidle = 0;
+  return r;
+}
+
+int
+uthread_write(int fd, const void *buf, int n)
+{
+  int r;
+
+  while((r = write(fd, buf, n)) == EAGAIN)
+    iowait();
+  nidle = 0;
+  return r;
+}
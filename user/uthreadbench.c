@@ -0,0 +1,191 @@
+// User-level thread benchmark.
+//
+// Measures a switch between two uthreads that take turns
+// yielding, and compares it with a switch between two
+// processes that take turns over a pair of pipes. Then runs
+// many uthreads at once, and passes data between uthreads
+// over an O_NONBLOCK pipe with uthread_read()/uthread_write().
+//
+//   uthreadbench [switches [threads]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+#define NSWITCH 100000
+#define NTHREAD 1000
+#define NBYTES 10000
+
+int nswitch, nyield;
+int fds[2];
+
+// nanoseconds per event, from an interval in mtime cycles.
+int
+perevent(uint64 t, int n)
+{
+  return (int)(t * (1000000000 / MTIME_HZ) / n);
+}
+
+void
+yielder(void *arg)
+{
+  int i;
+
+  for(i = 0; i < nyield; i++)
+    uthread_yield();
+}
+
+void
+producer(void *arg)
+{
+  char buf[64];
+  int i, n;
+
+  memset(buf, 'x', sizeof(buf));
+  for(i = 0; i < NBYTES; i += n){
+    n = NBYTES - i < sizeof(buf) ? NBYTES - i : sizeof(buf);
+    if((n = uthread_write(fds[1], buf, n)) <= 0){
+      fprintf(2, "uthreadbench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fds[1]);
+}
+
+void
+consumer(void *arg)
+{
+  char buf[64];
+  int n, total = 0;
+
+  while((n = uthread_read(fds[0], buf, sizeof(buf))) > 0)
+    total += n;
+  if(total != NBYTES){
+    fprintf(2, "uthreadbench: read %d bytes, expected %d\n", total, NBYTES);
+    exit(1);
+  }
+  close(fds[0]);
+}
+
+void
+uthreads(void)
+{
+  uint64 t0, t1;
+
+  nyield = nswitch / 2;
+  if(uthread_create(yielder, 0) < 0 || uthread_create(yielder, 0) < 0){
+    fprintf(2, "uthreadbench: uthread_create failed\n");
+    exit(1);
+  }
+  t0 = umtime();
+  uthread_run();
+  t1 = umtime();
+  printf("uthread switch: %d ns\n", perevent(t1 - t0, nswitch));
+}
+
+void
+processes(void)
+{
+  int p2c[2], c2p[2];
+  int i, pid;
+  uint64 t0, t1;
+  char c = 'x';
+
+  if(pipe(p2c) < 0 || pipe(c2p) < 0){
+    fprintf(2, "uthreadbench: pipe failed\n");
+    exit(1);
+  }
+  if((pid = fork()) < 0){
+    fprintf(2, "uthreadbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(p2c[1]);
+    close(c2p[0]);
+    while(read(p2c[0], &c, 1) == 1)
+      write(c2p[1], &c, 1);
+    exit(0);
+  }
+  close(p2c[0]);
+  close(c2p[1]);
+  // each round trip is two switches.
+  t0 = umtime();
+  for(i = 0; i < nswitch / 2; i++){
+    if(write(p2c[1], &c, 1) != 1 || read(c2p[0], &c, 1) != 1){
+      fprintf(2, "uthreadbench: round trip failed\n");
+      exit(1);
+    }
+  }
+  t1 = umtime();
+  close(p2c[1]);
+  close(c2p[0]);
+  wait(0);
+  printf("process switch: %d ns\n", perevent(t1 - t0, nswitch));
+}
+
+void
+many(int nthread)
+{
+  int i;
+  uint64 t0, t1;
+
+  nyield = 10;
+  t0 = umtime();
+  for(i = 0; i < nthread; i++){
+    if(uthread_create(yielder, 0) < 0){
+      fprintf(2, "uthreadbench: uthread_create %d failed\n", i);
+      exit(1);
+    }
+  }
+  uthread_run();
+  t1 = umtime();
+  printf("%d uthreads x %d yields: %d us\n", nthread, nyield,
+         perevent(t1 - t0, 1000));
+}
+
+void
+io(void)
+{
+  uint64 t0, t1;
+
+  if(pipe(fds) < 0){
+    fprintf(2, "uthreadbench: pipe failed\n");
+    exit(1);
+  }
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(fds[1], F_SETFL, O_NONBLOCK);
+  if(uthread_create(consumer, 0) < 0 || uthread_create(producer, 0) < 0){
+    fprintf(2, "uthreadbench: uthread_create failed\n");
+    exit(1);
+  }
+  t0 = umtime();
+  uthread_run();
+  t1 = umtime();
+  printf("%d bytes through a pipe: %d us\n", NBYTES, perevent(t1 - t0, 1000));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nthread;
+
+  nswitch = NSWITCH;
+  nthread = NTHREAD;
+  if(argc > 1)
+    nswitch = atoi(argv[1]);
+  if(argc > 2)
+    nthread = atoi(argv[2]);
+  if(nswitch < 2 || nthread <= 0){
+    fprintf(2, "usage: uthreadbench [switches [threads]]\n");
+    exit(1);
+  }
+
+  uthreads();
+  processes();
+  many(nthread);
+  io();
+  exit(0);
+}